@@ -0,0 +1,291 @@
+#include "Core/ParticleSimulation.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Sweeps particle count x compute kernel x workgroup size, each configuration being a fresh
+// headless run with warmup + measured steps, and writes the results as JSON and/or CSV.
+//   particles_bench --particles 65536,1048576 --kernels shader,popcorn --workgroup-sizes 64,256
+//                   --warmup-steps 50 --steps 300 --json bench.json --csv bench.csv
+// Any other option is a regular SimulationConfig one (--layout soa, --render, ...) applied to every run.
+// With --sort the kernels are replaced by RadixSort alone on particle count random keys, and
+// particles per second is keys per second:
+//   particles_bench --sort --particles 65536,262144,1048576,4194304 --workgroup-sizes 256 --csv sort.csv
+// With --scan they're replaced by PrefixScan's two paths, "subgroup" and "shared", on particle count
+// random values (a device without subgroup arithmetic reports the subgroup runs as failed):
+//   particles_bench --scan --particles 65536,1048576,4194304 --workgroup-sizes 256 --csv scan.csv
+
+namespace {
+    struct BenchOptions {
+        SimulationConfig baseConfig;
+
+        std::vector<uint32_t> particleCounts = { 65536, 262144, 1048576, 4194304 };
+        std::vector<std::string> kernels = { "shader", "gravity", "popcorn" };
+        std::vector<uint32_t> workgroupSizes = { 64, 128, 256, 512 };
+
+        bool sort = false;
+        bool scan = false;
+
+        std::string jsonPath;
+        std::string csvPath;
+    };
+
+    struct BenchResult {
+        uint32_t particles;
+        std::string kernel;
+        uint32_t workgroupSize;
+
+        SimulationRunStats stats;
+        std::string error;
+
+        double stepMs() const {
+            // GPU time when timestamps are there, wall clock otherwise
+            if (stats.compute.samples > 0) {
+                return stats.compute.averageMs;
+            }
+            return stats.wallMs / std::max<uint32_t>(stats.steps, 1);
+        }
+
+        double particlesPerSecond() const {
+            return stepMs() > 0.0 ? particles / (stepMs() / 1000.0) : 0.0;
+        }
+
+        double bytesPerSecond() const {
+            return stepMs() > 0.0 ? stats.computeBytesPerStep / (stepMs() / 1000.0) : 0.0;
+        }
+    };
+
+    std::vector<std::string> splitList(const std::string& value) {
+        std::vector<std::string> items;
+        std::stringstream stream(value);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            if (!item.empty()) {
+                items.push_back(item);
+            }
+        }
+        return items;
+    }
+
+    std::vector<uint32_t> splitUintList(const std::string& key, const std::string& value) {
+        std::vector<uint32_t> numbers;
+        for (const auto& item : splitList(value)) {
+            numbers.push_back(SimulationConfig::parseUint(key, item));
+        }
+
+        if (numbers.empty()) {
+            throw std::runtime_error("empty list for option: " + key);
+        }
+        return numbers;
+    }
+
+    BenchOptions parseArgs(int argc, char** argv) {
+        BenchOptions options;
+        options.baseConfig.steps = 300;
+        options.baseConfig.warmupSteps = 50;
+
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) != 0) {
+                throw std::runtime_error("unexpected argument: " + arg);
+            }
+
+            std::string key = arg.substr(2);
+            std::string value = "true";
+
+            size_t equals = key.find('=');
+            if (equals != std::string::npos) {
+                value = key.substr(equals + 1);
+                key = key.substr(0, equals);
+            } else if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+                value = argv[++i];
+            }
+
+            if (key == "particles") {
+                options.particleCounts = splitUintList(key, value);
+            } else if (key == "kernels") {
+                options.kernels = splitList(value);
+            } else if (key == "workgroup-sizes") {
+                options.workgroupSizes = splitUintList(key, value);
+            } else if (key == "sort") {
+                options.sort = value != "false" && value != "0" && value != "off";
+            } else if (key == "scan") {
+                options.scan = value != "false" && value != "0" && value != "off";
+            } else if (key == "json") {
+                options.jsonPath = value;
+            } else if (key == "csv") {
+                options.csvPath = value;
+            } else if (key == "scenario") {
+                options.baseConfig.loadScenarioFile(value);
+            } else {
+                options.baseConfig.applyOption(key, value);
+            }
+        }
+
+        // Always a headless profiled run, whatever was passed
+        options.baseConfig.headless = true;
+        options.baseConfig.profile = true;
+        options.baseConfig.output.clear();
+        options.baseConfig.profileCsv.clear();
+
+        if (options.sort) {
+            options.kernels = { "radix_sort" };
+        } else if (options.scan) {
+            options.kernels = { "subgroup", "shared" };
+        }
+
+        return options;
+    }
+
+    // Error messages are exception text, quotes and commas included
+    std::string escapeCsv(const std::string& value) {
+        std::string escaped = "\"";
+        for (char c : value) {
+            if (c == '"') {
+                escaped += '"';
+            }
+            escaped += c;
+        }
+        return escaped + "\"";
+    }
+
+    std::string escapeJson(const std::string& value) {
+        std::string escaped = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char code[7];
+                std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                escaped += code;
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped + "\"";
+    }
+
+    void writeCsv(const std::string& filepath, const std::vector<BenchResult>& results) {
+        std::ofstream file(filepath);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open csv file! " + filepath);
+        }
+
+        file << "particles,kernel,workgroup_size,steps,compute_avg_ms,compute_p50_ms,compute_p95_ms,"
+                "graphics_avg_ms,frame_avg_ms,frame_p95_ms,wall_ms_per_step,particles_per_second,bytes_per_second,error\n";
+
+        for (const auto& result : results) {
+            const auto& stats = result.stats;
+            file << result.particles << "," << result.kernel << "," << result.workgroupSize << "," << stats.steps << ","
+                 << stats.compute.averageMs << "," << stats.compute.p50Ms << "," << stats.compute.p95Ms << ","
+                 << stats.graphics.averageMs << "," << stats.frame.averageMs << "," << stats.frame.p95Ms << ","
+                 << stats.wallMs / std::max<uint32_t>(stats.steps, 1) << ","
+                 << result.particlesPerSecond() << "," << result.bytesPerSecond() << ","
+                 << escapeCsv(result.error) << "\n";
+        }
+    }
+
+    void writeJson(const std::string& filepath, const BenchOptions& options, const std::vector<BenchResult>& results) {
+        std::ofstream file(filepath);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open json file! " + filepath);
+        }
+
+        auto writePassStats = [&](const char* name, const GpuPassStats& stats) {
+            file << "      \"" << name << "\": { \"samples\": " << stats.samples
+                 << ", \"avg_ms\": " << stats.averageMs
+                 << ", \"p50_ms\": " << stats.p50Ms
+                 << ", \"p95_ms\": " << stats.p95Ms
+                 << ", \"p99_ms\": " << stats.p99Ms
+                 << ", \"max_ms\": " << stats.maxMs << " },\n";
+        };
+
+        file << "{\n";
+        file << "  \"layout\": \"" << options.baseConfig.getShaderVariant() << "\",\n";
+        file << "  \"warmup_steps\": " << options.baseConfig.warmupSteps << ",\n";
+        file << "  \"steps\": " << options.baseConfig.steps << ",\n";
+        file << "  \"render\": " << (options.baseConfig.render ? "true" : "false") << ",\n";
+        file << "  \"results\": [\n";
+
+        for (size_t i = 0; i < results.size(); i++) {
+            const auto& result = results[i];
+
+            file << "    {\n";
+            file << "      \"particles\": " << result.particles << ",\n";
+            file << "      \"kernel\": \"" << result.kernel << "\",\n";
+            file << "      \"workgroup_size\": " << result.workgroupSize << ",\n";
+            writePassStats("compute", result.stats.compute);
+            writePassStats("graphics", result.stats.graphics);
+            writePassStats("frame", result.stats.frame);
+            file << "      \"wall_ms_per_step\": " << result.stats.wallMs / std::max<uint32_t>(result.stats.steps, 1) << ",\n";
+            file << "      \"particles_per_second\": " << result.particlesPerSecond() << ",\n";
+            file << "      \"bytes_per_second\": " << result.bytesPerSecond() << ",\n";
+            file << "      \"error\": " << escapeJson(result.error) << "\n";
+            file << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+
+        file << "  ]\n";
+        file << "}\n";
+    }
+}
+
+int main(int argc, char **argv) {
+    try {
+        BenchOptions options = parseArgs(argc, argv);
+        std::vector<BenchResult> results;
+
+        for (uint32_t particles : options.particleCounts) {
+            for (const auto& kernel : options.kernels) {
+                for (uint32_t workgroupSize : options.workgroupSizes) {
+                    SimulationConfig config = options.baseConfig;
+                    if (options.scan) {
+                        config.applyOption("scan", kernel);
+                    } else if (!options.sort) {
+                        config.applyOption("kernel", kernel);
+                    }
+
+                    BenchResult result{ particles, kernel, workgroupSize, {}, {} };
+
+                    // A configuration the device can't do (e.g. workgroup too big) or the config rejects
+                    // (e.g. workgroup size 0) is reported, not fatal
+                    try {
+                        config.applyOption("particles", std::to_string(particles));
+                        config.applyOption("workgroup-size", std::to_string(workgroupSize));
+
+                        ParticleSimulation simulation(config);
+                        if (options.sort) {
+                            simulation.runSortBenchmark();
+                        } else if (options.scan) {
+                            simulation.runScanBenchmark();
+                        } else {
+                            simulation.run();
+                        }
+                        result.stats = simulation.getRunStats();
+                    } catch (const std::exception &e) {
+                        result.error = e.what();
+                        std::cerr << "Configuration failed: " << e.what() << std::endl;
+                    }
+
+                    std::cout << "Bench | particles " << particles << " | kernel " << kernel << " | workgroup " << workgroupSize
+                              << " | " << result.stepMs() << " ms/step | " << result.particlesPerSecond() / 1e6 << " Mparticles/s\n";
+
+                    results.push_back(result);
+                }
+            }
+        }
+
+        if (!options.csvPath.empty()) {
+            writeCsv(options.csvPath, results);
+        }
+        if (!options.jsonPath.empty()) {
+            writeJson(options.jsonPath, options, results);
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
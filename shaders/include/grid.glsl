@@ -0,0 +1,42 @@
+// Uniform grid over the [-1, 1] simulation box, rebuilt every step by grid_count, a PrefixScan of the
+// counts into cellStart and grid_scatter. After a build the particles are sorted by cell and cell c holds
+// the particles [cellStart[c], gridCellEnd(c)).
+// The box is bounded, so the cell is the plain row major index instead of a hash.
+// Must match SpatialGrid in SpatialGrid.hpp
+
+layout(constant_id = 1) const uint GRID_DIM = 128;
+layout(constant_id = 2) const float GRID_CELL_SIZE = 0.015625;
+
+layout(std430, set = 2, binding = 0) buffer CellCountSSBO {
+    uint cellCounts[ ];
+};
+
+layout(std430, set = 2, binding = 1) buffer CellStartSSBO {
+    uint cellStart[ ];
+};
+
+// Per particle, in the unsorted order: its cell and its position inside that cell
+layout(std430, set = 2, binding = 2) buffer ParticleCellSSBO {
+    uint particleCells[ ];
+};
+
+layout(std430, set = 2, binding = 3) buffer ParticleRankSSBO {
+    uint particleRanks[ ];
+};
+
+uint gridCellCount() {
+    return GRID_DIM * GRID_DIM;
+}
+
+uint gridCellEnd(uint cell) {
+    return cellStart[cell] + cellCounts[cell];
+}
+
+// Anything outside the box goes to the border cells
+ivec2 gridCoord(vec2 position) {
+    return clamp(ivec2(floor((position + 1.0) / GRID_CELL_SIZE)), ivec2(0), ivec2(int(GRID_DIM) - 1));
+}
+
+uint gridCellIndex(ivec2 coord) {
+    return uint(coord.y) * GRID_DIM + uint(coord.x);
+}
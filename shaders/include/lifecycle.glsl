@@ -0,0 +1,103 @@
+// Particle lifecycle, only for kernels simulating live particles alone (fountain). Every SSBO slot has a
+// list of the particles alive in it, next to the indirect arguments dispatching and drawing exactly those.
+// A step reads the in slot's list and writes the out slot's:
+//   step kernel      ages every live particle, pushes the dead ones on the dead stack and lists the others
+//   lifecycle_emit   pops dead particles and respawns them from the emitters, listing them too
+//   lifecycle_args   turns the out slot's live count into its indirect arguments
+// Compaction (lifecycle_compact_mark, PrefixScan, lifecycle_compact_scatter) packs a slot's live particles
+// to the front of the next one, see ParticleLifecycle::recordCompact().
+// Must match ParticleLifecycle in ParticleLifecycle.hpp
+
+// Must match Emitter in ParticleLifecycle.hpp
+struct Emitter {
+    vec2 position;
+    vec2 direction;
+
+    // Half angle of the launch cone, in radians
+    float spread;
+    float speed;
+
+    // Simulated time its particles live, every particle gets this give or take a quarter
+    float lifetime;
+    float padding;
+};
+
+// Per particle, in place (only ever touched by the thread owning the particle): x age, y lifetime
+layout(std430, set = 2, binding = 0) buffer LifetimeSSBO {
+    vec2 lifetimes[ ];
+};
+
+// Stack of dead particle indices, deadCount being its top
+layout(std430, set = 2, binding = 1) buffer DeadListSSBO {
+    uint deadList[ ];
+};
+
+layout(std430, set = 2, binding = 2) buffer LifecycleCounterSSBO {
+    int deadCount;
+};
+
+layout(std430, set = 2, binding = 3) readonly buffer EmitterSSBO {
+    Emitter emitters[ ];
+};
+
+layout(std430, set = 2, binding = 4) readonly buffer AliveInSSBO {
+    uint aliveIn[ ];
+};
+
+layout(std430, set = 2, binding = 5) buffer AliveOutSSBO {
+    uint aliveOut[ ];
+};
+
+// A VkDispatchIndirectCommand, the live count, then a VkDrawIndexedIndirectCommand over the alive list
+layout(std430, set = 2, binding = 6) readonly buffer ArgsInSSBO {
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+    uint aliveCount;
+} argsIn;
+
+layout(std430, set = 2, binding = 7) buffer ArgsOutSSBO {
+    uint dispatchX;
+    uint dispatchY;
+    uint dispatchZ;
+    uint aliveCount;
+
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+} argsOut;
+
+#ifdef LIFECYCLE_COMPACTION
+// Only bound when compacting: a flag per live particle, scanned into its packed index
+layout(std430, set = 2, binding = 8) buffer CompactOffsetSSBO {
+    uint compactOffsets[ ];
+};
+
+// The lifetimes in packed order, copied back over the originals after the scatter
+layout(std430, set = 2, binding = 9) writeonly buffer CompactLifetimeSSBO {
+    vec2 compactLifetimes[ ];
+};
+#endif
+
+void listAlive(uint index) {
+    aliveOut[atomicAdd(argsOut.aliveCount, 1)] = index;
+}
+
+void pushDead(uint index) {
+    deadList[atomicAdd(deadCount, 1)] = index;
+}
+
+// Only called from lifecycle_emit, where nothing pushes. An empty stack goes negative for a moment and is
+// put back, so no index is handed out twice. Returns false once every particle is alive
+bool popDead(out uint index) {
+    int top = atomicAdd(deadCount, -1) - 1;
+    if (top < 0) {
+        atomicAdd(deadCount, 1);
+        return false;
+    }
+
+    index = deadList[top];
+    return true;
+}
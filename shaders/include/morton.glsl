@@ -0,0 +1,20 @@
+// 2D Morton (Z-order) keys over the [-1, 1] box, 16 bits per axis interleaved with x in the even bits.
+// Particles close in the box get close keys, so sorting by key keeps neighbors together in memory
+
+// Spreads the low 16 bits to the even bits
+uint spreadBits(uint x) {
+    x &= 0x0000FFFFu;
+    x = (x | (x << 8)) & 0x00FF00FFu;
+    x = (x | (x << 4)) & 0x0F0F0F0Fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+
+// Anything outside the box lands on its border
+uint mortonKey(vec2 position) {
+    vec2 unit = clamp((position + 1.0) * 0.5, 0.0, 1.0);
+    uvec2 quantized = uvec2(unit * 65535.0);
+
+    return spreadBits(quantized.x) | (spreadBits(quantized.y) << 1);
+}
@@ -0,0 +1,32 @@
+// Gravity shared by the all pairs (nbody) and tree (barneshut) kernels. Must match NBodyReference.cpp
+
+// Softened pull of a body of the given mass, delta being the offset from the pulled particle to it.
+// The particle's own pull is exactly zero
+vec2 bodyPull(vec2 delta, float mass, float softening2) {
+    float inverseDistance = inversesqrt(dot(delta, delta) + softening2);
+    return delta * (mass * inverseDistance * inverseDistance * inverseDistance);
+}
+
+// Applies the summed pull and moves the particle, bouncing off the [-1, 1] walls
+ParticleState integrateBody(ParticleState self, vec2 acceleration) {
+    vec2 newVelocity = self.velocity + acceleration * params.attraction * params.deltaTime;
+    vec2 newPosition = self.position + newVelocity * params.deltaTime;
+
+    if (newPosition.x < -1.0) {
+        newPosition.x = -1.0;
+        newVelocity.x = abs(newVelocity.x) * params.airResist;
+    } else if (newPosition.x > 1.0) {
+        newPosition.x = 1.0;
+        newVelocity.x = -abs(newVelocity.x) * params.airResist;
+    }
+
+    if (newPosition.y < -1.0) {
+        newPosition.y = -1.0;
+        newVelocity.y = abs(newVelocity.y) * params.airResist;
+    } else if (newPosition.y > 1.0) {
+        newPosition.y = 1.0;
+        newVelocity.y = -abs(newVelocity.y) * params.airResist;
+    }
+
+    return ParticleState(newPosition, newVelocity);
+}
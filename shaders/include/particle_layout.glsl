@@ -0,0 +1,113 @@
+// Particle storage shared by every compute kernel, picked at compile time:
+//   PARTICLE_LAYOUT_SOA         position, velocity and color each in their own stream
+//   (default)                   one interleaved Particle record per particle
+//   PARTICLE_ENCODING_COMPACT   fp32 position, half2 velocity and unorm4x8 color (16 bytes)
+//   (default)                   fp32 everything (32 bytes)
+// Kernels only go through loadParticle/storeParticle so they don't care which one they got.
+// Particles optionally carry a mass in the color alpha (loadMass), which is never drawn.
+// Must match Particle::getStreams in AppTypes.hpp
+
+struct ParticleState {
+    vec2 position;
+    vec2 velocity;
+};
+
+#ifdef PARTICLE_ENCODING_COMPACT
+    #define VELOCITY_TYPE uint
+    #define COLOR_TYPE uint
+    #define decodeVelocity(v) unpackHalf2x16(v)
+    #define encodeVelocity(v) packHalf2x16(v)
+#else
+    #define VELOCITY_TYPE vec2
+    #define COLOR_TYPE vec4
+    #define decodeVelocity(v) (v)
+    #define encodeVelocity(v) (v)
+#endif
+
+#ifdef PARTICLE_LAYOUT_SOA
+
+// Color is only written at spawn, so the kernels never touch it
+layout(std430, binding = 1) readonly buffer PositionSSBOIn {
+    vec2 positionsIn[ ];
+};
+
+layout(std430, binding = 2) buffer PositionSSBOOut {
+    vec2 positionsOut[ ];
+};
+
+layout(std430, binding = 4) readonly buffer VelocitySSBOIn {
+    VELOCITY_TYPE velocitiesIn[ ];
+};
+
+layout(std430, binding = 5) buffer VelocitySSBOOut {
+    VELOCITY_TYPE velocitiesOut[ ];
+};
+
+uint particleCount() {
+    return positionsOut.length();
+}
+
+ParticleState loadParticle(uint index) {
+    return ParticleState(positionsIn[index], decodeVelocity(velocitiesIn[index]));
+}
+
+void storeParticle(uint index, ParticleState particle) {
+    positionsOut[index] = particle.position;
+    velocitiesOut[index] = encodeVelocity(particle.velocity);
+}
+
+// Moves a particle unchanged to another index, without decoding it
+void copyParticle(uint src, uint dst) {
+    positionsOut[dst] = positionsIn[src];
+    velocitiesOut[dst] = velocitiesIn[src];
+}
+
+// The color stream isn't bound to the kernels, every particle weighs the same
+float loadMass(uint index) {
+    return 1.0;
+}
+
+#else
+
+struct Particle {
+    vec2 position;
+    VELOCITY_TYPE velocity;
+    COLOR_TYPE color;
+};
+
+layout(std430, binding = 1) readonly buffer ParticleSSBOIn {
+    Particle particlesIn[ ];
+};
+
+layout(std430, binding = 2) buffer ParticleSSBOOut {
+    Particle particlesOut[ ];
+};
+
+uint particleCount() {
+    return particlesOut.length();
+}
+
+ParticleState loadParticle(uint index) {
+    return ParticleState(particlesIn[index].position, decodeVelocity(particlesIn[index].velocity));
+}
+
+// The output record is a whole new copy, so the color has to be carried over
+void storeParticle(uint index, ParticleState particle) {
+    particlesOut[index].position = particle.position;
+    particlesOut[index].velocity = encodeVelocity(particle.velocity);
+    particlesOut[index].color = particlesIn[index].color;
+}
+
+void copyParticle(uint src, uint dst) {
+    particlesOut[dst] = particlesIn[src];
+}
+
+float loadMass(uint index) {
+#ifdef PARTICLE_ENCODING_COMPACT
+    return unpackUnorm4x8(particlesIn[index].color).a;
+#else
+    return particlesIn[index].color.a;
+#endif
+}
+
+#endif
@@ -0,0 +1,98 @@
+// Exclusive prefix sum of uints in place, reduce-then-scan over blocks of SCAN_BLOCK_SIZE:
+//   pass 0: every workgroup scans its block on its own, the block total goes to blockSums
+//   pass 1: a single workgroup scans blockSums, tile by tile, so any block count fits
+//   pass 2: every workgroup adds its scanned block total back
+// prefix_scan_subgroup and prefix_scan_shared only differ in workgroupExclusiveScan(), which each
+// defines after including this. Only used through PrefixScan, which has its own pipeline layout.
+// Must match PrefixScan in PrefixScan.hpp
+
+#define SCAN_THREADS 128
+#define ITEMS_PER_THREAD 8
+#define SCAN_BLOCK_SIZE (SCAN_THREADS * ITEMS_PER_THREAD)
+
+layout (local_size_x = SCAN_THREADS, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, set = 0, binding = 0) buffer ScanValueSSBO {
+    uint scanValues[ ];
+};
+
+layout(std430, set = 0, binding = 1) buffer ScanBlockSumSSBO {
+    uint blockSums[ ];
+};
+
+// Pass, and element count (values, or block sums for pass 1)
+layout(push_constant) uniform ScanPassParams {
+    uint pass;
+    uint count;
+} scanPass;
+
+// Exclusive prefix sum of one value per thread across the workgroup, total getting the sum of all of them.
+// Called from uniform control flow, and safe to call again right after (it syncs before touching shared memory)
+uint workgroupExclusiveScan(uint value, out uint total);
+
+uint loadScanValue(uint index) {
+    if (index >= scanPass.count) {
+        return 0;
+    }
+    return scanPass.pass == 0 ? scanValues[index] : blockSums[index];
+}
+
+void storeScanValue(uint index, uint value) {
+    if (index >= scanPass.count) {
+        return;
+    }
+
+    if (scanPass.pass == 0) {
+        scanValues[index] = value;
+    } else {
+        blockSums[index] = value;
+    }
+}
+
+// Scans the block starting at blockBegin with carry added to every result, returns the block's total
+uint scanBlock(uint blockBegin, uint carry) {
+    uint first = blockBegin + gl_LocalInvocationID.x * ITEMS_PER_THREAD;
+
+    uint values[ITEMS_PER_THREAD];
+    uint threadSum = 0;
+    for (uint i = 0; i < ITEMS_PER_THREAD; i++) {
+        values[i] = loadScanValue(first + i);
+        threadSum += values[i];
+    }
+
+    uint total;
+    uint running = carry + workgroupExclusiveScan(threadSum, total);
+    for (uint i = 0; i < ITEMS_PER_THREAD; i++) {
+        storeScanValue(first + i, running);
+        running += values[i];
+    }
+
+    return total;
+}
+
+void main()
+{
+    if (scanPass.pass == 2) {
+        uint blockOffset = blockSums[gl_WorkGroupID.x];
+        uint first = gl_WorkGroupID.x * SCAN_BLOCK_SIZE + gl_LocalInvocationID.x * ITEMS_PER_THREAD;
+        for (uint i = 0; i < ITEMS_PER_THREAD; i++) {
+            if (first + i < scanPass.count) {
+                scanValues[first + i] += blockOffset;
+            }
+        }
+        return;
+    }
+
+    if (scanPass.pass == 0) {
+        uint total = scanBlock(gl_WorkGroupID.x * SCAN_BLOCK_SIZE, 0);
+        if (gl_LocalInvocationID.x == 0) {
+            blockSums[gl_WorkGroupID.x] = total;
+        }
+        return;
+    }
+
+    uint carry = 0;
+    for (uint blockBegin = 0; blockBegin < scanPass.count; blockBegin += SCAN_BLOCK_SIZE) {
+        carry += scanBlock(blockBegin, carry);
+    }
+}
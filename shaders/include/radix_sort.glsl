@@ -0,0 +1,42 @@
+// Key/value LSD radix sort, 4 bits per pass, each pass being radix_count, a PrefixScan of the digit counts
+// and radix_scatter. The passes ping-pong between the A and B buffers, an even pass count ends in A.
+// Only used through RadixSort, which has its own pipeline layout. Must match RadixSort in RadixSort.hpp
+
+#define RADIX 16
+
+layout(std430, set = 0, binding = 0) buffer KeyASSBO {
+    uint keysA[ ];
+};
+
+layout(std430, set = 0, binding = 1) buffer ValueASSBO {
+    uint valuesA[ ];
+};
+
+layout(std430, set = 0, binding = 2) buffer KeyBSSBO {
+    uint keysB[ ];
+};
+
+layout(std430, set = 0, binding = 3) buffer ValueBSSBO {
+    uint valuesB[ ];
+};
+
+// Per digit per workgroup key counts, digit major, scanned in place into scatter offsets
+// (this is the PrefixScan's value buffer)
+layout(std430, set = 0, binding = 4) buffer DigitCountSSBO {
+    uint digitCounts[ ];
+};
+
+// Key count, digit shift and whether B is the input
+layout(push_constant) uniform RadixPassParams {
+    uint count;
+    uint shift;
+    uint flip;
+} sortPass;
+
+uint loadKey(uint index) {
+    return sortPass.flip == 0 ? keysA[index] : keysB[index];
+}
+
+uint keyDigit(uint key) {
+    return (key >> sortPass.shift) & (RADIX - 1);
+}
@@ -0,0 +1,37 @@
+// Counter based random numbers, Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// No state anywhere: four 32 bit values are a pure function of (run seed, stream) as the key and
+// (global particle index, step, salt) as the counter, so any step of any particle can be redrawn later,
+// on the GPU or bit for bit on the CPU. Must match CounterRng in CounterRng.hpp
+
+// Every user draws from its own stream, so two kernels never see the same numbers
+#define RNG_STREAM_INITIALIZE 0u
+#define RNG_STREAM_POPCORN 1u
+#define RNG_STREAM_GRAVITY 2u
+#define RNG_STREAM_EMIT 3u
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+uvec4 philox4x32(uvec4 counter, uvec2 key) {
+    for (int round = 0; round < 10; round++) {
+        uint hi0, lo0, hi1, lo1;
+        umulExtended(PHILOX_M0, counter.x, hi0, lo0);
+        umulExtended(PHILOX_M1, counter.z, hi1, lo1);
+
+        counter = uvec4(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += uvec2(PHILOX_W0, PHILOX_W1);
+    }
+    return counter;
+}
+
+// Salt tells apart several draws of the same particle and step
+uvec4 randomBits(uint seed, uint stream, uint index, uint step, uint salt) {
+    return philox4x32(uvec4(index, step, salt, 0u), uvec2(seed, stream));
+}
+
+// The top 24 bits, exactly representable, so the CPU gets the very same floats
+vec4 randomUnit(uint seed, uint stream, uint index, uint step, uint salt) {
+    return vec4(randomBits(seed, stream, index, step, salt) >> 8u) * (1.0 / 16777216.0);
+}
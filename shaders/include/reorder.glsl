@@ -0,0 +1,29 @@
+// Periodic Morton order re-sort of the particle buffers, every few frames before the step:
+//   reorder_keys       the Morton key of every particle, its index as the value
+//   RadixSort          sorts the keys, see radix_sort.glsl
+//   reorder_permute    gathers every particle to its sorted place, into the sorted slot the step then reads
+// Both kernels also count the neighbors in memory sharing a grid cell, the before/after locality numbers.
+// Has its own pipeline layout: set 0 the particles in/out as usual, set 1 this.
+// Must match MortonReorder in MortonReorder.hpp
+
+// The top 12 key bits are a 64x64 cell of the box
+#define REORDER_CELL_SHIFT 20
+
+// Morton keys and their particle indices, sorted by RadixSort in place (its buffers)
+layout(std430, set = 1, binding = 0) buffer KeySSBO {
+    uint reorderKeys[ ];
+};
+
+layout(std430, set = 1, binding = 1) buffer ValueSSBO {
+    uint reorderParticles[ ];
+};
+
+// Particles i and i + 1 in the same cell, in the order before and after the sort
+layout(std430, set = 1, binding = 2) buffer CounterSSBO {
+    uint sameCellBefore;
+    uint sameCellAfter;
+};
+
+bool sameReorderCell(uint keyA, uint keyB) {
+    return (keyA >> REORDER_CELL_SHIFT) == (keyB >> REORDER_CELL_SHIFT);
+}
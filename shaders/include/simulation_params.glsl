@@ -0,0 +1,38 @@
+// Per-step parameters, written every frame into a persistently mapped uniform buffer and picked
+// with a dynamic offset, so the recorded command buffers never change. Must match SimulationParams in AppTypes.hpp
+
+layout(std140, set = 1, binding = 0) uniform SimulationParams {
+    float deltaTime;
+
+    // Run seed and step counter, which key the counter based RNG (include/random.glsl)
+    uint seed;
+    uint stepIndex;
+
+    // Tunable physics, unused ones are ignored by the kernel
+    float gravity;
+    float airResist;
+    float resetSpeedThreshold;
+    float launchStrength;
+
+    // Collisions, disc radius in simulation units and the fraction of the approach speed kept
+    float particleRadius;
+    float restitution;
+
+    // N-body, pull strength, softening length and whether particles use their own mass (0 or 1)
+    float attraction;
+    float softening;
+    uint useMass;
+
+    // Barnes-Hut, cells smaller than this times their distance are pulled as a single body
+    float openingAngle;
+
+    // Lifecycle, particles the emitters spawn this step
+    uint emitCount;
+} params;
+
+// Global index of the dispatch's first particle. Chunks bind their own buffers, so the local index
+// restarts at 0 in every chunk, and this turns it back into the particle's index in the whole set.
+// Must match the push constant range in ParticleSimulation::createComputePipeline
+layout(push_constant) uniform ChunkParams {
+    uint firstParticle;
+} chunk;
@@ -0,0 +1,48 @@
+// Hash of the whole simulated state, for comparing runs step by step without reading the particles back.
+// Every particle hashes its index and decoded position/velocity bits twice (xxHash32 style, two seeds),
+// and the per particle hashes are summed with wrapping adds, so the result doesn't depend on which thread
+// gets there first. Has its own pipeline layout: set 0 the particles (only the in side is read), set 1 this.
+// Must match StateHasher in StateHasher.hpp
+
+#define XXH_PRIME32_1 0x9E3779B1u
+#define XXH_PRIME32_2 0x85EBCA77u
+#define XXH_PRIME32_3 0xC2B2AE3Du
+#define XXH_PRIME32_4 0x27D4EB2Fu
+#define XXH_PRIME32_5 0x165667B1u
+
+layout(std430, set = 1, binding = 0) buffer StateHashSSBO {
+    uint hashSums[2];
+};
+
+// Where the bound chunk starts in the whole particle buffer
+layout(push_constant) uniform StateHashParams {
+    uint firstParticle;
+} hashChunk;
+
+uint rotateLeft(uint value, uint bits) {
+    return (value << bits) | (value >> (32u - bits));
+}
+
+uint xxhWord(uint hash, uint word) {
+    hash += word * XXH_PRIME32_3;
+    return rotateLeft(hash, 17u) * XXH_PRIME32_4;
+}
+
+uint xxhAvalanche(uint hash) {
+    hash ^= hash >> 15;
+    hash *= XXH_PRIME32_2;
+    hash ^= hash >> 13;
+    hash *= XXH_PRIME32_3;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+uint hashWords(uint seed, uint index, uvec4 words) {
+    uint hash = seed + XXH_PRIME32_5 + 20u;
+    hash = xxhWord(hash, index);
+    hash = xxhWord(hash, words.x);
+    hash = xxhWord(hash, words.y);
+    hash = xxhWord(hash, words.z);
+    hash = xxhWord(hash, words.w);
+    return xxhAvalanche(hash);
+}
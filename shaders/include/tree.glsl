@@ -0,0 +1,49 @@
+// Linear BVH over the particles (Karras 2012), rebuilt every step by the tree_* kernels:
+//   tree_morton        a 32 bit Morton key per particle, the particle index as its value
+//   RadixSort          sorts the keys, see radix_sort.glsl
+//   tree_build         the binary radix tree over the sorted keys, one thread per internal node
+//   tree_summarize     mass, center of mass and bounds of every node, bottom up from the leaves
+// Nodes [0, leafCount - 1) are internal with node 0 the root, leaf k is node leafCount - 1 + k and
+// stands for particle mortonParticles[k]. Must match BarnesHutTree in BarnesHutTree.hpp
+
+#define TREE_NO_PARENT 0xFFFFFFFFu
+
+// Morton keys and their particle indices, sorted by RadixSort in place (its buffers)
+layout(std430, set = 2, binding = 0) buffer KeySSBO {
+    uint mortonKeys[ ];
+};
+
+layout(std430, set = 2, binding = 1) buffer ValueSSBO {
+    uint mortonParticles[ ];
+};
+
+layout(std430, set = 2, binding = 2) buffer NodeChildrenSSBO {
+    uvec2 nodeChildren[ ];
+};
+
+layout(std430, set = 2, binding = 3) coherent buffer NodeParentSSBO {
+    uint nodeParents[ ];
+};
+
+// xy center of mass, z mass
+layout(std430, set = 2, binding = 4) coherent buffer NodeBodySSBO {
+    vec4 nodeBodies[ ];
+};
+
+// xy min corner, zw max corner
+layout(std430, set = 2, binding = 5) coherent buffer NodeBoundsSSBO {
+    vec4 nodeBounds[ ];
+};
+
+// Children done summarizing, per internal node
+layout(std430, set = 2, binding = 6) buffer NodeVisitSSBO {
+    uint nodeVisits[ ];
+};
+
+uint treeLeafCount() {
+    return mortonKeys.length();
+}
+
+uint treeInternalCount() {
+    return treeLeafCount() - 1;
+}
@@ -0,0 +1,201 @@
+#include "PrefixScan.hpp"
+
+#include <array>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t SCAN_BINDING_COUNT = 2;
+
+    void recordComputeToCompute(VkCommandBuffer commandBuffer) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+bool PrefixScan::supportsSubgroups(DeviceContext& deviceCtx) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(deviceCtx.m_physicalDevice, &properties);
+
+    VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+    return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0
+        && (subgroupProperties.supportedOperations & needed) == needed;
+}
+
+PrefixScan::PrefixScan(DeviceContext& deviceCtx, uint32_t maxCount, ScanPath path, const std::string& shaderDir)
+    : m_deviceCtx(deviceCtx), m_maxCount(maxCount), m_path(path) {
+    if (maxCount == 0) {
+        throw std::runtime_error("prefix scan needs room for at least one value!");
+    }
+
+    if (path == ScanPath::Subgroup && !supportsSubgroups(deviceCtx)) {
+        throw std::runtime_error("the device has no subgroup arithmetic in compute shaders, use the shared scan!");
+    }
+
+    createBuffers();
+    createDescriptors();
+    createPipeline(shaderDir);
+}
+
+PrefixScan::~PrefixScan() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_scanPipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+GpuBuffer& PrefixScan::getValues() {
+    return *m_values;
+}
+
+uint32_t PrefixScan::getMaxCount() const {
+    return m_maxCount;
+}
+
+ScanPath PrefixScan::getPath() const {
+    return m_path;
+}
+
+void PrefixScan::createBuffers() {
+    auto createBuffer = [&](VkDeviceSize size, VkBufferUsageFlags extraUsage) {
+        return std::make_unique<GpuBuffer>(
+            m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx.m_computeQueueCtx
+        );
+    };
+
+    // Callers may fill and read the values with transfers too
+    m_values = createBuffer(static_cast<VkDeviceSize>(m_maxCount) * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_blockSums = createBuffer(static_cast<VkDeviceSize>(divideRoundingUp(m_maxCount, SCAN_BLOCK_SIZE)) * sizeof(uint32_t), 0);
+}
+
+void PrefixScan::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::array<VkDescriptorSetLayoutBinding, SCAN_BINDING_COUNT> bindings{};
+    for (uint32_t i = 0; i < SCAN_BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create prefix scan descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = SCAN_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create prefix scan descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate prefix scan descriptor set!");
+    }
+
+    // Binding order must match shaders/include/prefix_scan.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, *m_values);
+    writer.addStorageBufferBinding(m_descriptorSet, 1, *m_blockSums);
+    writer.writeAll(device);
+}
+
+void PrefixScan::createPipeline(const std::string& shaderDir) {
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+
+    if (vkCreatePipelineLayout(m_deviceCtx.m_logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create prefix scan pipeline layout!");
+    }
+
+    // Fixed workgroup size, no specialization
+    std::string path = shaderDir + (m_path == ScanPath::Subgroup ? "/prefix_scan_subgroup.comp.spv" : "/prefix_scan_shared.comp.spv");
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_scanPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create prefix scan pipeline! " + path);
+    }
+}
+
+void PrefixScan::recordPass(VkCommandBuffer commandBuffer, uint32_t pass, uint32_t count, uint32_t groupCount) {
+    std::array<uint32_t, 2> pushConstants = { pass, count };
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, PUSH_CONSTANT_SIZE, pushConstants.data());
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    recordComputeToCompute(commandBuffer);
+}
+
+void PrefixScan::recordScan(VkCommandBuffer commandBuffer, uint32_t count) {
+    if (count > m_maxCount) {
+        throw std::runtime_error("too many values for this prefix scan!");
+    }
+    if (count == 0) {
+        return;
+    }
+
+    uint32_t blockCount = divideRoundingUp(count, SCAN_BLOCK_SIZE);
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_scanPipeline);
+
+    recordPass(commandBuffer, 0, count, blockCount);
+    recordPass(commandBuffer, 1, blockCount, 1);
+    recordPass(commandBuffer, 2, count, blockCount);
+}
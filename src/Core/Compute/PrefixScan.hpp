@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// How a workgroup scans its values: subgroup arithmetic (GL_KHR_shader_subgroup_arithmetic) or the
+// shared memory Hillis-Steele scan, which runs anywhere
+enum class ScanPath {
+    Subgroup,
+    Shared
+};
+
+// Exclusive GPU prefix sum of 32 bit values, in place. Reduce-then-scan, three dispatches of the
+// path's kernel (see shaders/include/prefix_scan.glsl):
+//   pass 0  every block of SCAN_BLOCK_SIZE values scanned on its own, block totals to the side
+//   pass 1  one workgroup scans the block totals
+//   pass 2  the scanned totals added back
+// Self contained like RadixSort: write the values into getValues(), record a scan, read the offsets
+// back from the same buffer
+class PrefixScan {
+public:
+    static constexpr uint32_t SCAN_BLOCK_SIZE = 1024;
+
+    static constexpr uint32_t PUSH_CONSTANT_SIZE = 2 * sizeof(uint32_t);
+
+    // Whether the device can run the subgroup path, arithmetic subgroup operations in compute shaders
+    static bool supportsSubgroups(DeviceContext& deviceCtx);
+
+    // shaderDir is any compiled variant directory, the scan kernels don't depend on the particle layout
+    PrefixScan(DeviceContext& deviceCtx, uint32_t maxCount, ScanPath path, const std::string& shaderDir);
+    ~PrefixScan();
+
+    PrefixScan(const PrefixScan&) = delete;
+    PrefixScan& operator=(const PrefixScan&) = delete;
+
+    GpuBuffer& getValues();
+
+    uint32_t getMaxCount() const;
+    ScanPath getPath() const;
+
+    // Scans the first count values. Expects their writes made visible to compute shaders before, and
+    // leaves the offsets visible to compute shaders and transfers. Binds its own pipeline layout, so
+    // anything bound through another layout has to be bound again after
+    void recordScan(VkCommandBuffer commandBuffer, uint32_t count);
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_maxCount;
+    ScanPath m_path;
+
+    std::unique_ptr<GpuBuffer> m_values;
+    std::unique_ptr<GpuBuffer> m_blockSums;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_scanPipeline = VK_NULL_HANDLE;
+
+    void createBuffers();
+    void createDescriptors();
+    void createPipeline(const std::string& shaderDir);
+
+    void recordPass(VkCommandBuffer commandBuffer, uint32_t pass, uint32_t count, uint32_t groupCount);
+};
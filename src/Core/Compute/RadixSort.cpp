@@ -0,0 +1,231 @@
+#include "RadixSort.hpp"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t SORT_BINDING_COUNT = 5;
+    constexpr uint32_t KEY_BITS = 32;
+
+    void recordComputeToCompute(VkCommandBuffer commandBuffer) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+RadixSort::RadixSort(DeviceContext& deviceCtx, uint32_t maxCount, uint32_t workgroupSize, ScanPath scanPath, const std::string& shaderDir)
+    : m_deviceCtx(deviceCtx), m_maxCount(maxCount), m_workgroupSize(workgroupSize) {
+    if (maxCount == 0) {
+        throw std::runtime_error("radix sort needs room for at least one key!");
+    }
+
+    m_scan = std::make_unique<PrefixScan>(deviceCtx, RADIX * getGroupCount(maxCount), scanPath, shaderDir);
+
+    createBuffers();
+    createDescriptors();
+    createPipelines(shaderDir);
+}
+
+RadixSort::~RadixSort() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_countPipeline, nullptr);
+    vkDestroyPipeline(device, m_scatterPipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+GpuBuffer& RadixSort::getKeys() {
+    return *m_keys[0];
+}
+
+GpuBuffer& RadixSort::getValues() {
+    return *m_values[0];
+}
+
+uint32_t RadixSort::getMaxCount() const {
+    return m_maxCount;
+}
+
+uint32_t RadixSort::getGroupCount(uint32_t count) const {
+    return divideRoundingUp(count, m_workgroupSize);
+}
+
+void RadixSort::createBuffers() {
+    VkDeviceSize keyBytes = static_cast<VkDeviceSize>(m_maxCount) * sizeof(uint32_t);
+
+    auto createBuffer = [&](VkDeviceSize size, VkBufferUsageFlags extraUsage) {
+        return std::make_unique<GpuBuffer>(
+            m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx.m_computeQueueCtx
+        );
+    };
+
+    // Callers may fill and read the input/result with transfers too
+    m_keys[0] = createBuffer(keyBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_values[0] = createBuffer(keyBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_keys[1] = createBuffer(keyBytes, 0);
+    m_values[1] = createBuffer(keyBytes, 0);
+}
+
+void RadixSort::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::array<VkDescriptorSetLayoutBinding, SORT_BINDING_COUNT> bindings{};
+    for (uint32_t i = 0; i < SORT_BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create radix sort descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = SORT_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create radix sort descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate radix sort descriptor set!");
+    }
+
+    // Binding order must match shaders/include/radix_sort.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, *m_keys[0]);
+    writer.addStorageBufferBinding(m_descriptorSet, 1, *m_values[0]);
+    writer.addStorageBufferBinding(m_descriptorSet, 2, *m_keys[1]);
+    writer.addStorageBufferBinding(m_descriptorSet, 3, *m_values[1]);
+    writer.addStorageBufferBinding(m_descriptorSet, 4, m_scan->getValues());
+    writer.writeAll(device);
+}
+
+VkPipeline RadixSort::createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create radix sort pipeline! " + path);
+    }
+
+    return pipeline;
+}
+
+void RadixSort::createPipelines(const std::string& shaderDir) {
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = PUSH_CONSTANT_SIZE;
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+
+    if (vkCreatePipelineLayout(m_deviceCtx.m_logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create radix sort pipeline layout!");
+    }
+
+    // local_size_x_id = 0
+    VkSpecializationMapEntry workgroupSizeEntry{};
+    workgroupSizeEntry.constantID = 0;
+    workgroupSizeEntry.offset = 0;
+    workgroupSizeEntry.size = sizeof(uint32_t);
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &workgroupSizeEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &m_workgroupSize;
+
+    m_countPipeline = createPipeline(shaderDir + "/radix_count.comp.spv", specializationInfo);
+    m_scatterPipeline = createPipeline(shaderDir + "/radix_scatter.comp.spv", specializationInfo);
+}
+
+void RadixSort::recordPass(VkCommandBuffer commandBuffer, uint32_t count, uint32_t shift, uint32_t flip, uint32_t groupCount) {
+    std::array<uint32_t, 3> pushConstants = { count, shift, flip };
+    vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, PUSH_CONSTANT_SIZE, pushConstants.data());
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    recordComputeToCompute(commandBuffer);
+}
+
+void RadixSort::recordSort(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits) {
+    if (count > m_maxCount) {
+        throw std::runtime_error("too many keys for this radix sort!");
+    }
+    if (count <= 1) {
+        return;
+    }
+
+    uint32_t groupCount = getGroupCount(count);
+    uint32_t digitCountSize = RADIX * groupCount;
+
+    // An even pass count leaves the result back in the first buffers
+    uint32_t passCount = divideRoundingUp(std::min(keyBits, KEY_BITS), RADIX_BITS);
+    passCount += passCount % 2;
+
+    for (uint32_t pass = 0; pass < passCount; pass++) {
+        uint32_t shift = pass * RADIX_BITS;
+        uint32_t flip = pass % 2;
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_countPipeline);
+        recordPass(commandBuffer, count, shift, flip, groupCount);
+
+        // Binds its own layout, so the set goes back in after
+        m_scan->recordScan(commandBuffer, digitCountSize);
+
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_scatterPipeline);
+        recordPass(commandBuffer, count, shift, flip, groupCount);
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Compute/PrefixScan.hpp"
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Stable GPU sort of 32 bit keys carrying 32 bit values (usually particle indices), reduce-then-scan
+// LSD radix with 4 bit digits. Every pass is:
+//   radix_count    per workgroup digit counts
+//   PrefixScan     exclusive prefix sum of all the counts, giving every workgroup's offsets
+//   radix_scatter  each key to its offset plus its rank among the workgroup's keys of the same digit
+// Self contained: its own buffers, descriptor set and pipeline layout (see shaders/include/radix_sort.glsl),
+// so anything can use it. Write the keys and values into getKeys()/getValues() (e.g. by binding them in
+// your own descriptor set), record a sort, and read them back sorted from the same buffers
+class RadixSort {
+public:
+    static constexpr uint32_t RADIX_BITS = 4;
+    static constexpr uint32_t RADIX = 1 << RADIX_BITS;
+
+    static constexpr uint32_t PUSH_CONSTANT_SIZE = 3 * sizeof(uint32_t);
+
+    // scanPath is the digit count scan's. shaderDir is any compiled variant directory, the sort kernels
+    // don't depend on the particle layout
+    RadixSort(DeviceContext& deviceCtx, uint32_t maxCount, uint32_t workgroupSize, ScanPath scanPath, const std::string& shaderDir);
+    ~RadixSort();
+
+    RadixSort(const RadixSort&) = delete;
+    RadixSort& operator=(const RadixSort&) = delete;
+
+    GpuBuffer& getKeys();
+    GpuBuffer& getValues();
+
+    uint32_t getMaxCount() const;
+
+    // Sorts the first count keys by their lowest keyBits bits, rounded up to an even number of passes.
+    // Expects the key/value writes made visible to compute shaders before, and leaves the sorted ones
+    // visible to compute shaders and transfers. Binds its own pipeline layout, so anything bound
+    // through another layout has to be bound again after
+    void recordSort(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits = 32);
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_maxCount;
+    uint32_t m_workgroupSize;
+
+    // Index 0 holds the input and the result, 1 the odd passes' output
+    std::unique_ptr<GpuBuffer> m_keys[2];
+    std::unique_ptr<GpuBuffer> m_values[2];
+
+    // Its values are the digit counts
+    std::unique_ptr<PrefixScan> m_scan;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_countPipeline = VK_NULL_HANDLE;
+    VkPipeline m_scatterPipeline = VK_NULL_HANDLE;
+
+    uint32_t getGroupCount(uint32_t count) const;
+
+    void createBuffers();
+    void createDescriptors();
+    void createPipelines(const std::string& shaderDir);
+    VkPipeline createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo);
+
+    void recordPass(VkCommandBuffer commandBuffer, uint32_t count, uint32_t shift, uint32_t flip, uint32_t groupCount);
+};
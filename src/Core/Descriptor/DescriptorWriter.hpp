@@ -36,6 +36,21 @@ public:
         writeSets.push_back(descriptorConfig);
     }
 
+    // The offset is given at bind time, range is how much of the buffer each bind sees
+    void addDynamicUniformBufferBinding(VkDescriptorSet& dstSet, const uint32_t dst, const GpuBuffer& buffer, const VkDeviceSize range, const uint32_t count = 1) {
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = buffer.m_vkBuffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = range;
+
+        bufferInfos.push_back(bufferInfo);
+
+        VkWriteDescriptorSet descriptorConfig = addBinding(dstSet, dst, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, count);
+        descriptorConfig.pBufferInfo = &bufferInfos.back();
+
+        writeSets.push_back(descriptorConfig);
+    }
+
     void addImageBinding(VkDescriptorSet& dstSet, const uint32_t dst, const Texture& texture, const VkImageLayout imageLayout, const uint32_t count = 1) {
         VkDescriptorImageInfo imageInfo{};
         imageInfo.imageLayout = imageLayout;
@@ -1,13 +1,17 @@
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <numeric>
+#include <optional>
 #include <random>
 #include <stdexcept>
 #include <string>
@@ -21,15 +25,33 @@
 #include <stb_image.h>
 #include <tiny_obj_loader.h>
 
+#include "Core/Compute/PrefixScan.hpp"
+#include "Core/Compute/RadixSort.hpp"
 #include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/CommandBufferCache.hpp"
 #include "Core/RHI/GpuBuffer.hpp"
+#include "Core/RHI/GpuProfiler.hpp"
 #include "Core/RHI/Pipeline/PipelineBuilder.hpp"
 #include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/DeviceMemoryAllocator.hpp"
+#include "Core/RHI/FrameScheduler.hpp"
+#include "Core/RHI/StagingRing.hpp"
+#include "Core/RHI/UniformRing.hpp"
 #include "Core/RHI/Types/Vertex.hpp"
 #include "Core/RHI/Window/WindowContext.hpp"
 #include "Core/RHI/Window/GlfwWindowContext.hpp"
+#include "Core/RHI/Window/HeadlessWindowContext.hpp"
 #include "Core/Resources/Image.hpp"
 #include "Core/Resources/Texture.hpp"
+#include "Core/Simulation/BarnesHutTree.hpp"
+#include "Core/Simulation/MortonReorder.hpp"
+#include "Core/Simulation/CounterRng.hpp"
+#include "Core/Simulation/NBodyReference.hpp"
+#include "Core/Simulation/ParticleInitializer.hpp"
+#include "Core/Simulation/ParticleLifecycle.hpp"
+#include "Core/Simulation/SimulationConfig.hpp"
+#include "Core/Simulation/SpatialGrid.hpp"
+#include "Core/Simulation/StateHasher.hpp"
 #include "RHI/Pipeline/ShaderStageBuilder.hpp"
 #include "RHI/Types/AppTypes.hpp"
 
@@ -49,48 +71,107 @@ const std::vector<const char *> instanceExtensions = { VK_KHR_GET_PHYSICAL_DEVIC
 const uint32_t WIDTH = 1200;
 const uint32_t HEIGHT = 800;
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
-
-// const uint32_t PARTICLE_COUNT = 8192;
-// const uint32_t PARTICLE_COUNT = 16384;
-// const uint32_t PARTICLE_COUNT = 32768;
-// const uint32_t PARTICLE_COUNT = 32768;
-// const uint32_t PARTICLE_COUNT = 65536;
-// const uint32_t PARTICLE_COUNT = 131072;
-// const uint32_t PARTICLE_COUNT = 262144;
-// const uint32_t PARTICLE_COUNT = 524288;
-const uint32_t PARTICLE_COUNT = 1048576;
-// const uint32_t PARTICLE_COUNT = 2097152;
-// const uint32_t PARTICLE_COUNT = 4194304;
-// const uint32_t PARTICLE_COUNT = 8388608;
-// const uint32_t PARTICLE_COUNT = 16777216;
-// const uint32_t PARTICLE_COUNT = 33554432;
-// const uint32_t PARTICLE_COUNT = 67108864;
+// Which SSBO slots a compute step reads and writes. Frames with several substeps ping-pong
+// between the frame's own buffers and a shared scratch slot, so the last step always lands
+// in the frame's buffers and the previous frame's (possibly still being drawn) are only read
+enum ComputeRoute : uint32_t {
+    PreviousToCurrent = 0,
+    PreviousToScratch,
+    ScratchToCurrent,
+    CurrentToScratch,
+    COMPUTE_ROUTE_COUNT
+};
+
+// A contiguous slice of the particle set living in its own SSBO
+struct ParticleChunk {
+    uint32_t firstParticle;
+    uint32_t particleCount;
+};
+
+// Measured part of a headless run, after the warmup steps
+struct SimulationRunStats {
+    uint32_t steps = 0;
+    double wallMs = 0.0;
+
+    // Only filled when profiling
+    GpuPassStats compute;
+    GpuPassStats graphics;
+    GpuPassStats frame;
+
+    // Bytes the kernels read and write per step, counting every substep of it
+    uint64_t computeBytesPerStep = 0;
+
+    // Only with the Morton re-sort, over the whole run
+    MortonReorderStats reorder;
+};
 
 class ParticleSimulation {
   public:
+    explicit ParticleSimulation(const SimulationConfig &config) : m_config(config), m_physics(config.getPhysics()) {}
+
+    const SimulationRunStats& getRunStats() const {
+        return m_runStats;
+    }
+
+    // Live tunable, picked up by the next compute step. The collision radius stops at half a grid cell
+    PhysicsParams& getPhysics() {
+        return m_physics;
+    }
+
     void run() {
+        m_config.print();
+
         initWindow();
         initVulkan();
+        if (m_config.validate) {
+            validateKernel();
+        }
         mainLoop();
         cleanup();
     }
 
+    // Sorts particleCount random keys warmupSteps + steps times instead of simulating, see benchmarkSort()
+    void runSortBenchmark() {
+        m_config.print();
+
+        initWindow();
+        initVulkan();
+        benchmarkSort();
+        cleanup();
+    }
+
+    // Scans particleCount random values warmupSteps + steps times with the configured scan, see benchmarkScan()
+    void runScanBenchmark() {
+        m_config.print();
+
+        initWindow();
+        initVulkan();
+        benchmarkScan();
+        cleanup();
+    }
+
   private:
+    SimulationConfig m_config;
+    PhysicsParams m_physics;
+    SimulationRunStats m_runStats;
+
     std::unique_ptr<WindowContext> m_windowCtx;
     VkInstance instance;
 
     VkDebugUtilsMessengerEXT debugMessenger;
 
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
 
-    VkSwapchainKHR swapChain;
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
     std::vector<VkImage> swapChainImages;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
     std::vector<VkImageView> swapChainImageViews;
     std::vector<VkFramebuffer> swapChainFramebuffers;
 
+    // Headless runs render into this instead of a swap chain image
+    std::unique_ptr<Image> m_offscreenImage;
+
     bool framebufferResized = false;
     
     VkRenderPass renderPass;
@@ -101,14 +182,29 @@ class ParticleSimulation {
     VkPipelineLayout m_computePipelineLayout;
     VkPipeline m_computePipeline;
     VkDescriptorSetLayout m_computeDescriptorSetLayout;
+    VkDescriptorSetLayout m_stepParamsDescriptorSetLayout;
     
     std::vector<uint32_t> indices;
     std::vector<Vertex> vertices;
     
-    std::vector<std::unique_ptr<GpuBuffer>> m_uniformBuffers;
-    std::vector<std::unique_ptr<GpuBuffer>> m_shaderStorageBuffers;
+    // Per-step parameters, a slice of the ring per frame slot holding one SimulationParams per substep.
+    // Rewritten every frame, recorded command buffers only carry the dynamic offsets
+    std::unique_ptr<UniformRing> m_stepParams;
+    std::vector<uint32_t> m_stepParamsOffsets;
+    VkDescriptorSet m_stepParamsDescriptorSet;
+    uint32_t m_stepIndex = 0;
+
+    // Steps the current frame runs, and the fixed timestep time not yet simulated
+    uint32_t m_frameSubsteps = 1;
+    double m_stepAccumulator = 0.0;
+
+    // Indexed [frame][chunk][stream], streams that aren't simulated are shared by every frame.
+    // Frames use the slots round robin, see getSimulationSlotCount(). With substeps there's one
+    // more slot after those, the scratch buffers, and with the grid or the Morton re-sort one more, the sorted buffers
+    std::vector<ParticleStream> m_particleStreams;
+    std::vector<ParticleChunk> m_particleChunks;
+    std::vector<std::vector<std::vector<std::shared_ptr<GpuBuffer>>>> m_shaderStorageBuffers;
 
-    std::vector<std::unique_ptr<GpuBuffer>> m_rngUbo;
     
     uint32_t mipLevels;
 
@@ -120,34 +216,89 @@ class ParticleSimulation {
     std::unique_ptr<Image> m_depthImage;
 
     VkDescriptorPool descriptorPool;
-    std::vector<VkDescriptorSet> m_computeDescriptorSets;
-
+    // Indexed [simulation slot][route][chunk], only PreviousToCurrent exists without substeps.
+    // With the grid the step reads the sorted slot instead of the route's input
+    std::vector<std::vector<std::vector<VkDescriptorSet>>> m_computeDescriptorSets;
+
+    // Neighbor grid, only when m_config.usesGrid()
+    std::unique_ptr<SpatialGrid> m_grid;
+
+    // Barnes-Hut tree, only for the barneshut kernel. Built from the step's own input right before it
+    std::unique_ptr<BarnesHutTree> m_tree;
+
+    // Morton re-sort, only with m_config.mortonSortInterval. Runs before the first substep of every
+    // interval'th frame, which then reads the sorted slot through m_resortedDescriptorSets. The lifecycle's
+    // compaction (m_config.compactInterval) goes the same way, see usesResort()
+    std::unique_ptr<MortonReorder> m_reorder;
+    std::vector<std::vector<VkDescriptorSet>> m_resortedDescriptorSets;
+    bool m_resortFrame = false;
+
+    // Live particle lists and emitters, only for lifecycle kernels. Steps dispatch and frames draw through it.
+    // The accumulator holds the fraction of a particle not emitted yet
+    std::unique_ptr<ParticleLifecycle> m_lifecycle;
+    double m_emitAccumulator = 0.0;
+
+    // The grid, the re-sort and the compaction read the route's input and write the sorted slot, these are
+    // their particle sets indexed [simulation slot][route] (all need a single chunk)
+    std::vector<std::vector<VkDescriptorSet>> m_sortDescriptorSets;
+
+    // See getScanPath()
+    std::optional<ScanPath> m_scanPath;
+
+    // State hashes, only with m_config.hashInterval. The frame whose steps cross a multiple of the interval
+    // hashes its own slot at the end, through m_hashDescriptorSets indexed [simulation slot][chunk] (in = out)
+    std::unique_ptr<StateHasher> m_hasher;
+    std::vector<std::vector<VkDescriptorSet>> m_hashDescriptorSets;
+    bool m_hashFrame = false;
+
+    // Recorded every frame, only used until the frames reach their steady state, see isSteadyState()
     std::vector<VkCommandBuffer> commandBuffers;
     std::vector<VkCommandBuffer> m_computeCommandBuffers;
 
+    // Recorded once and replayed after that, see getComputeCommandBuffer()/getGraphicsCommandBuffer()
+    std::unique_ptr<CommandBufferCache> m_computeCache;
+    std::unique_ptr<CommandBufferCache> m_graphicsCache;
+
+    // Swap chain acquire/present still need binary semaphores, everything else goes through m_scheduler
     std::vector <VkSemaphore> imageAvailableSemaphores;
     std::vector <VkSemaphore> renderFinishedSemaphores;
-    std::vector <VkFence> inFlightFences;
-    
-    std::vector<VkFence> m_computeInFlightFences;
-    std::vector<VkSemaphore> m_computeFinishedSemaphores;
 
+    std::unique_ptr<FrameScheduler> m_scheduler;
+
+    // Frame slot (command buffers, query pools) and SSBO slot of the frame being built
     uint32_t currentFrame = 0;
+    uint32_t m_simulationSlot = 0;
+
+    // SSBO slot graphics draws this frame, a finished state getRenderLag() frames behind compute.
+    // The first frames have nothing finished yet and only clear
+    uint32_t m_renderSlot = 0;
+    bool m_hasRenderState = false;
+
+    // Triple buffering with separate compute/graphics queue families, see recordOwnershipTransfer()
+    bool m_ownershipTransfers = false;
 
     std::unique_ptr<DeviceContext> m_deviceCtx;
 
+    std::unique_ptr<GpuProfiler> m_profiler;
+
     double lastFrameTime = 0.0f;
     double lastTime = 0.0f;
 
     std::mt19937 rngEngine{};
-    std::uniform_real_distribution<float> rngDist{};
+
+    // Keys every counter based draw of the run, initial particles and kernels alike (see CounterRng)
+    uint32_t m_seed = 0;
 
     void initWindow() {
-        m_windowCtx = std::make_unique<GlfwWindowContext>(
-            WIDTH, HEIGHT, 
-            "Particles!", 
-            [this](int w, int h) { framebufferResizeCallback(w,  h); }
-        );
+        if (m_config.headless) {
+            m_windowCtx = std::make_unique<HeadlessWindowContext>(WIDTH, HEIGHT, static_cast<uint64_t>(m_config.warmupSteps) + m_config.steps);
+        } else {
+            m_windowCtx = std::make_unique<GlfwWindowContext>(
+                WIDTH, HEIGHT, 
+                "Particles!", 
+                [this](int w, int h) { framebufferResizeCallback(w,  h); }
+            );
+        }
 
         lastTime = m_windowCtx->getTime();
     }
@@ -158,6 +309,7 @@ class ParticleSimulation {
     }
 
     void initVulkan() {
+        checkDeterministic();
         createRngEngine();
 
         createInstance();
@@ -165,27 +317,41 @@ class ParticleSimulation {
   
         m_windowCtx->createSurface(instance, surface);
   
-        m_deviceCtx = std::make_unique<DeviceContext>(instance, surface, deviceExtensions, enableValidationLayers, validationLayers);
+        m_deviceCtx = std::make_unique<DeviceContext>(instance, surface, getRequiredDeviceExtensions(), enableValidationLayers, validationLayers);
+
+        if (m_config.profile) {
+            m_profiler = std::make_unique<GpuProfiler>(*m_deviceCtx, m_config.framesInFlight, m_config.profileCsv, std::max<size_t>(512, m_config.steps));
+        }
 
         msaaSamples = m_deviceCtx->getMaxUsableSampleCount();
         msaaSamples = VK_SAMPLE_COUNT_1_BIT; // TODO: Overwriting for now
 
-        createSwapChain();
-        createImageViews();
+        if (m_config.headless) {
+            createOffscreenTarget();
+        } else {
+            createSwapChain();
+            createImageViews();
+        }
         
         createRenderPass();
         createDescriptorSetLayout();
+        createGrid();
+        createTree();
+        createReorder();
+        createLifecycle();
+        createStateHasher();
 
         createGraphicsPipeline();
         createComputePipeline();
 
         createFramebuffers();
 
-        createUniformBuffers();
-
+        createParticleChunks();
         createShaderStorageBuffers();
         initialiazeParticles();
 
+        createStepParams();
+
         createDescriptorPool();
         createDescriptorSets();
 
@@ -200,17 +366,18 @@ class ParticleSimulation {
 
         cleanupSwapChain();
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < m_config.framesInFlight; i++) {
             vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
             vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-            vkDestroyFence(device, inFlightFences[i], nullptr);
-
-            vkDestroySemaphore(device, m_computeFinishedSemaphores[i], nullptr);
-            vkDestroyFence(device, m_computeInFlightFences[i], nullptr);
         }
+        m_scheduler.reset();
+
+        m_computeCache.reset();
+        m_graphicsCache.reset();
         
         vkDestroyDescriptorPool(device, descriptorPool, nullptr);
         vkDestroyDescriptorSetLayout(device, m_computeDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_stepParamsDescriptorSetLayout, nullptr);
         
         vkDestroyPipeline(device, m_graphicsPipeline, nullptr);
         vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
@@ -219,13 +386,19 @@ class ParticleSimulation {
         vkDestroyPipeline(device, m_computePipeline, nullptr);
         vkDestroyPipelineLayout(device, m_computePipelineLayout, nullptr);
        
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            m_uniformBuffers[i].reset();
-            m_rngUbo[i].reset();
-        }
+        m_shaderStorageBuffers.clear();
+        m_stepParams.reset();
+        m_grid.reset();
+        m_tree.reset();
+        m_reorder.reset();
+        m_lifecycle.reset();
+        m_hasher.reset();
+        m_profiler.reset();
 
         m_deviceCtx.reset();
-        vkDestroySurfaceKHR(instance, surface, nullptr);
+        if (surface != VK_NULL_HANDLE) {
+            vkDestroySurfaceKHR(instance, surface, nullptr);
+        }
         
         if (enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
@@ -235,13 +408,30 @@ class ParticleSimulation {
         m_windowCtx.reset();
     }
 
-    void createRngEngine() {
-        rngEngine.seed((unsigned)time(nullptr));
-        rngDist = std::uniform_real_distribution<float>(0.0f, 1.0f);
+    // Same seed, same build, same device: same hashes. Anything whose outcome depends on which thread wins
+    // an atomic (the grid's scatter, the lifecycle's lists) or on the wall clock (the step rate) is out
+    void checkDeterministic() {
+        if (!m_config.deterministic) {
+            return;
+        }
+
+        if (m_config.stepRate > 0.0f) {
+            throw std::runtime_error("deterministic runs need a fixed amount of steps per frame, drop the step rate!");
+        }
+        if (m_config.usesGrid() || m_config.usesLifecycle()) {
+            throw std::runtime_error("the " + m_config.kernel + " kernel" + (m_config.grid ? " with the grid" : "") + " isn't deterministic!");
+        }
     }
 
-    float getRandomFloat() {
-        return rngDist(rngEngine);
+    void createRngEngine() {
+        if (m_config.seed || m_config.deterministic) {
+            m_seed = m_config.seed.value_or(0);
+            rngEngine.seed(m_seed);
+        } else {
+            rngEngine.seed((unsigned)time(nullptr));
+            m_seed = static_cast<uint32_t>(rngEngine());
+        }
+        std::cout << "Seed: " << m_seed << "\n";
     }
 
     void createInstance() {
@@ -300,6 +490,20 @@ class ParticleSimulation {
         return extensions;
     }
 
+    // No presenting without a surface, so headless runs don't ask for the swap chain extension
+    std::vector<const char*> getRequiredDeviceExtensions() {
+        std::vector<const char*> extensions;
+
+        for (const char* extension : deviceExtensions) {
+            if (m_config.headless && strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
+                continue;
+            }
+            extensions.push_back(extension);
+        }
+
+        return extensions;
+    }
+
     bool checkForVkInstanceExtensionsSupport(std::vector<const char *>instanceExtensions) {
         uint32_t extensionCount = 0;
         vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
@@ -420,7 +624,7 @@ class ParticleSimulation {
         // TODO: Understand this
         // Validation layer suggests having as many fences and semaphores as there's swap chain images
         // Maybe I should do it the other way around instead, cap the semaphores for swap chain images and not the swap chain images for frames in flight
-        uint32_t imageCount = MAX_FRAMES_IN_FLIGHT;
+        uint32_t imageCount = std::max(m_config.framesInFlight, swapChainSupport.capabilities.minImageCount);
 
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -537,6 +741,12 @@ class ParticleSimulation {
             vkDestroyFramebuffer(device, framebuffer, nullptr);
         }
 
+        // The offscreen image owns its view
+        if (m_config.headless) {
+            m_offscreenImage.reset();
+            return;
+        }
+
         for (auto imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
         }
@@ -544,6 +754,59 @@ class ParticleSimulation {
         vkDestroySwapchainKHR(device, swapChain, nullptr);
     }
 
+    // Poses as a single image swap chain so the render pass, framebuffers and draw recording don't change
+    void createOffscreenTarget() {
+        swapChainImageFormat = VK_FORMAT_R8G8B8A8_UNORM;
+        m_windowCtx->getFramebufferSize(swapChainExtent.width, swapChainExtent.height);
+
+        m_offscreenImage = std::make_unique<Image>(
+            &*m_deviceCtx,
+            swapChainExtent.width,
+            swapChainExtent.height,
+            1,
+            VK_SAMPLE_COUNT_1_BIT,
+            swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT
+        );
+
+        swapChainImages = { m_offscreenImage->m_vkImage };
+        swapChainImageViews = { m_offscreenImage->m_imageView };
+    }
+
+    // Writes the last rendered offscreen frame as a binary PPM
+    void saveOffscreenImage(const std::string& filepath) {
+        uint32_t width = m_offscreenImage->m_width;
+        uint32_t height = m_offscreenImage->m_height;
+        VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+
+        GpuBuffer readbackBuffer(
+            *m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_deviceCtx->m_graphicsQueueCtx
+        );
+        readbackBuffer.copyFromImage(*m_offscreenImage);
+
+        std::vector<uint8_t> pixels(size);
+        readbackBuffer.mapAndRead(pixels.data(), size);
+
+        std::ofstream file(filepath, std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open output image! " + filepath);
+        }
+
+        file << "P6\n" << width << " " << height << "\n255\n";
+        for (size_t i = 0; i < pixels.size(); i += 4) {
+            file.write(reinterpret_cast<const char*>(&pixels[i]), 3);
+        }
+
+        std::cout << "Saved offscreen frame to " << filepath << "\n";
+    }
+
     void recreateSwapChain() {
         uint32_t width, height;
         do {
@@ -553,6 +816,9 @@ class ParticleSimulation {
 
         vkDeviceWaitIdle(m_deviceCtx->m_logicalDevice);
 
+        // Cached draws point at the old framebuffers
+        m_graphicsCache->clear();
+
         cleanupSwapChain();
 
         createSwapChain();
@@ -591,7 +857,7 @@ class ParticleSimulation {
         colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        colorAttachment.finalLayout = m_config.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference colorAttachmentRef{};
         colorAttachmentRef.attachment = 0;
@@ -625,39 +891,52 @@ class ParticleSimulation {
     }
 
     void createDescriptorSetLayout() {
-        std::array<VkDescriptorSetLayoutBinding, 4> layoutBindings{};
-        layoutBindings[0].binding = 0;
-        layoutBindings[0].descriptorCount = 1;
-        layoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        layoutBindings[0].pImmutableSamplers = nullptr;
-        layoutBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-        layoutBindings[1].binding = 1;
-        layoutBindings[1].descriptorCount = 1;
-        layoutBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        layoutBindings[1].pImmutableSamplers = nullptr;
-        layoutBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-        layoutBindings[2].binding = 2;
-        layoutBindings[2].descriptorCount = 1;
-        layoutBindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        layoutBindings[2].pImmutableSamplers = nullptr;
-        layoutBindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-        layoutBindings[3].binding = 3;
-        layoutBindings[3].descriptorCount = 1;
-        layoutBindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        layoutBindings[3].pImmutableSamplers = nullptr;
-        layoutBindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        m_particleStreams = Particle::getStreams(m_config.layout, m_config.encoding);
+
+        std::vector<VkDescriptorSetLayoutBinding> layoutBindings{};
+
+        auto addBinding = [&](uint32_t binding, VkDescriptorType type) {
+            VkDescriptorSetLayoutBinding layoutBinding{};
+            layoutBinding.binding = binding;
+            layoutBinding.descriptorCount = 1;
+            layoutBinding.descriptorType = type;
+            layoutBinding.pImmutableSamplers = nullptr;
+            layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            layoutBindings.push_back(layoutBinding);
+        };
+
+        // An in/out pair for every stream the kernels rewrite
+        for (const auto& stream : m_particleStreams) {
+            if (stream.simulated) {
+                addBinding(stream.inBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+                addBinding(stream.outBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+            }
+        }
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.bindingCount = layoutBindings.size();
+        layoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
         layoutInfo.pBindings = layoutBindings.data();
 
         if (vkCreateDescriptorSetLayout(m_deviceCtx->m_logicalDevice, &layoutInfo, nullptr, &m_computeDescriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create compute descriptor set layout!");
         }
+
+        // Set 1, the per-step parameters
+        VkDescriptorSetLayoutBinding paramsBinding{};
+        paramsBinding.binding = 0;
+        paramsBinding.descriptorCount = 1;
+        paramsBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        paramsBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo paramsLayoutInfo{};
+        paramsLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        paramsLayoutInfo.bindingCount = 1;
+        paramsLayoutInfo.pBindings = &paramsBinding;
+
+        if (vkCreateDescriptorSetLayout(m_deviceCtx->m_logicalDevice, &paramsLayoutInfo, nullptr, &m_stepParamsDescriptorSetLayout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create step params descriptor set layout!");
+        }
     }
 
     void createGraphicsPipeline() {
@@ -674,13 +953,13 @@ class ParticleSimulation {
         builder.addShaderStage(ShaderStageBuilder::createShaderStage(m_deviceCtx->m_logicalDevice, VK_SHADER_STAGE_VERTEX_BIT, "shaders/shader.vert.spv"));
         builder.addShaderStage(ShaderStageBuilder::createShaderStage(m_deviceCtx->m_logicalDevice, VK_SHADER_STAGE_FRAGMENT_BIT, "shaders/shader.frag.spv"));
 
-        auto bindingDescription = Particle::getBindingDescription();
-        auto attributeDescriptions = Particle::getAttributeDescriptions();
+        auto bindingDescriptions = Particle::getBindingDescriptions(m_config.layout, m_config.encoding);
+        auto attributeDescriptions = Particle::getAttributeDescriptions(m_config.layout, m_config.encoding);
         
         builder.m_vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        builder.m_vertexInputInfo.vertexBindingDescriptionCount = 1;
+        builder.m_vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
         builder.m_vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-        builder.m_vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        builder.m_vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
         builder.m_vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
         // Create pipeline layout
@@ -705,13 +984,49 @@ class ParticleSimulation {
         // Compute Pipeline
         VkPipelineLayoutCreateInfo computePipelineLayoutInfo{};
         computePipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        computePipelineLayoutInfo.setLayoutCount = 1;
-        computePipelineLayoutInfo.pSetLayouts = &m_computeDescriptorSetLayout;
+        std::vector<VkDescriptorSetLayout> computeSetLayouts = { m_computeDescriptorSetLayout, m_stepParamsDescriptorSetLayout };
+        computePipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(computeSetLayouts.size());
+        computePipelineLayoutInfo.pSetLayouts = computeSetLayouts.data();
+
+        // The grid kernels share this layout, see SpatialGrid
+        if (m_grid) {
+            computeSetLayouts.push_back(m_grid->getDescriptorSetLayout());
+            computePipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(computeSetLayouts.size());
+            computePipelineLayoutInfo.pSetLayouts = computeSetLayouts.data();
+        }
+
+        // And so do the tree ones, see BarnesHutTree, and the lifecycle ones, see ParticleLifecycle
+        if (m_tree) {
+            computeSetLayouts.push_back(m_tree->getDescriptorSetLayout());
+            computePipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(computeSetLayouts.size());
+            computePipelineLayoutInfo.pSetLayouts = computeSetLayouts.data();
+        }
+        if (m_lifecycle) {
+            computeSetLayouts.push_back(m_lifecycle->getDescriptorSetLayout());
+            computePipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(computeSetLayouts.size());
+            computePipelineLayoutInfo.pSetLayouts = computeSetLayouts.data();
+        }
+
+        // The chunk's first particle, see shaders/include/simulation_params.glsl
+        VkPushConstantRange chunkPushConstants{};
+        chunkPushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        chunkPushConstants.offset = 0;
+        chunkPushConstants.size = sizeof(uint32_t);
+        computePipelineLayoutInfo.pushConstantRangeCount = 1;
+        computePipelineLayoutInfo.pPushConstantRanges = &chunkPushConstants;
 
         if (vkCreatePipelineLayout(m_deviceCtx->m_logicalDevice, &computePipelineLayoutInfo, nullptr, &m_computePipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create compute pipeline layout!");
         }
 
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_deviceCtx->m_physicalDevice, &properties);
+
+        if (m_config.workgroupSize > properties.limits.maxComputeWorkGroupSize[0] ||
+            m_config.workgroupSize > properties.limits.maxComputeWorkGroupInvocations) {
+            throw std::runtime_error("workgroup size " + std::to_string(m_config.workgroupSize) + " is over the device limit!");
+        }
+
         VkComputePipelineCreateInfo computePipelineInfo{};
         computePipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
         computePipelineInfo.layout = m_computePipelineLayout;
@@ -720,14 +1035,196 @@ class ParticleSimulation {
             ShaderStageBuilder::createShaderStage(
                 m_deviceCtx->m_logicalDevice,
                 VK_SHADER_STAGE_COMPUTE_BIT,
-                // "shaders/shader.comp.spv"
-                // "shaders/gravity.comp.spv"
-                "shaders/popcorn.comp.spv"
+                "shaders/" + m_config.getShaderVariant() + "/" + m_config.kernel + ".comp.spv"
             );
 
+        // local_size_x_id = 0
+        VkSpecializationMapEntry workgroupSizeEntry{};
+        workgroupSizeEntry.constantID = 0;
+        workgroupSizeEntry.offset = 0;
+        workgroupSizeEntry.size = sizeof(uint32_t);
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = 1;
+        specializationInfo.pMapEntries = &workgroupSizeEntry;
+        specializationInfo.dataSize = sizeof(uint32_t);
+        specializationInfo.pData = &m_config.workgroupSize;
+
+        // Kernels reading the grid also need its dimensions
+        GridSpecialization gridSpecialization{};
+        std::array<VkSpecializationMapEntry, 3> gridEntries = SpatialGrid::getSpecializationEntries();
+        if (m_grid) {
+            gridSpecialization = m_grid->getSpecialization(m_config.workgroupSize);
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(gridEntries.size());
+            specializationInfo.pMapEntries = gridEntries.data();
+            specializationInfo.dataSize = sizeof(gridSpecialization);
+            specializationInfo.pData = &gridSpecialization;
+        }
+
+        computePipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
         if (vkCreateComputePipelines(m_deviceCtx->m_logicalDevice, VK_NULL_HANDLE, 1, &computePipelineInfo, nullptr, &m_computePipeline) != VK_SUCCESS) {
             throw std::runtime_error("failed to create compute pipeline!");
         }
+
+        if (m_grid) {
+            m_grid->createPipelines(m_computePipelineLayout, "shaders/" + m_config.getShaderVariant(), m_config.workgroupSize);
+        }
+        if (m_tree) {
+            m_tree->createPipelines(m_computePipelineLayout);
+        }
+        if (m_lifecycle) {
+            m_lifecycle->createPipelines(m_computePipelineLayout);
+        }
+    }
+
+    // The sort moves whole particles around, spawn only streams (the SoA color) would be left behind
+    void createGrid() {
+        if (!m_config.usesGrid()) {
+            return;
+        }
+
+        for (const auto& stream : m_particleStreams) {
+            if (!stream.simulated) {
+                throw std::runtime_error("the grid needs a particle layout without spawn only streams, use --layout aos!");
+            }
+        }
+
+        m_grid = std::make_unique<SpatialGrid>(*m_deviceCtx, m_config.particleCount, m_config.getGridCellSize(), getScanPath(), "shaders/" + m_config.getShaderVariant());
+        std::cout << "Grid: " << m_grid->getGridDim() << "x" << m_grid->getGridDim() << " cells\n";
+    }
+
+    void createTree() {
+        if (m_config.kernel != "barneshut") {
+            return;
+        }
+
+        if (m_grid) {
+            throw std::runtime_error("the barneshut kernel can't be combined with the grid!");
+        }
+
+        m_tree = std::make_unique<BarnesHutTree>(*m_deviceCtx, m_config.particleCount, m_config.workgroupSize, getScanPath(), "shaders/" + m_config.getShaderVariant());
+        std::cout << "Barnes-Hut tree: " << m_tree->getNodeCount() << " nodes\n";
+    }
+
+    // Moves whole particles around like the grid, so the same layout restriction
+    void createReorder() {
+        if (m_config.mortonSortInterval == 0) {
+            return;
+        }
+
+        if (m_grid) {
+            throw std::runtime_error("the Morton re-sort can't be combined with the grid, which sorts every step already!");
+        }
+
+        for (const auto& stream : m_particleStreams) {
+            if (!stream.simulated) {
+                throw std::runtime_error("the Morton re-sort needs a particle layout without spawn only streams, use --layout aos!");
+            }
+        }
+
+        m_reorder = std::make_unique<MortonReorder>(
+            *m_deviceCtx,
+            m_config.particleCount,
+            m_config.workgroupSize,
+            m_config.framesInFlight,
+            m_computeDescriptorSetLayout,
+            getScanPath(),
+            "shaders/" + m_config.getShaderVariant()
+        );
+    }
+
+    void createStateHasher() {
+        if (m_config.hashInterval == 0) {
+            return;
+        }
+
+        m_hasher = std::make_unique<StateHasher>(
+            *m_deviceCtx,
+            m_config.workgroupSize,
+            m_config.framesInFlight,
+            m_computeDescriptorSetLayout,
+            m_config.hashLog,
+            "shaders/" + m_config.getShaderVariant()
+        );
+    }
+
+    // Emitters evenly spread along the floor, launching up. Particles keep their index between compactions
+    // and the lists point at them, so nothing else may move particles around
+    void createLifecycle() {
+        if (!m_config.usesLifecycle()) {
+            return;
+        }
+
+        if (m_grid || m_reorder) {
+            throw std::runtime_error("the " + m_config.kernel + " kernel can't be combined with the grid or the Morton re-sort!");
+        }
+
+        // Compaction moves whole particles around like the grid, so the same layout restriction
+        std::optional<ScanPath> compactionScan;
+        if (m_config.compactInterval > 0) {
+            for (const auto& stream : m_particleStreams) {
+                if (!stream.simulated) {
+                    throw std::runtime_error("compaction needs a particle layout without spawn only streams, use --layout aos!");
+                }
+            }
+            compactionScan = getScanPath();
+        }
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_deviceCtx->m_physicalDevice, &properties);
+        if (m_config.particleCount - 1 > properties.limits.maxDrawIndexedIndexValue) {
+            throw std::runtime_error("too many particles for an indexed draw on this device!");
+        }
+
+        std::vector<Emitter> emitters(m_config.emitters);
+        for (uint32_t i = 0; i < m_config.emitters; i++) {
+            emitters[i].position = glm::vec2(-1.0f + 2.0f * (i + 0.5f) / m_config.emitters, 0.95f);
+            emitters[i].direction = glm::vec2(0.0f, -1.0f);
+            emitters[i].spread = 0.35f;
+            emitters[i].speed = m_physics.launchStrength;
+            emitters[i].lifetime = m_config.lifetime;
+        }
+
+        // Room for the accumulator's leftover particle on top of a step's worth
+        uint32_t maxEmitCount = static_cast<uint32_t>(std::ceil(m_config.getEmitRate() * m_config.deltaTime)) + 1;
+
+        std::vector<uint32_t> sharedFamilies;
+        if (isRendering()) {
+            sharedFamilies = {
+                m_deviceCtx->m_computeQueueCtx.queueFamilyIndex,
+                m_deviceCtx->m_graphicsQueueCtx.queueFamilyIndex
+            };
+        }
+
+        m_lifecycle = std::make_unique<ParticleLifecycle>(
+            *m_deviceCtx,
+            m_config.particleCount,
+            getSortedSlot() + (compactionScan ? 1 : 0), // Every simulation slot, the scratch and the compaction's
+            maxEmitCount,
+            m_config.workgroupSize,
+            emitters,
+            sharedFamilies,
+            compactionScan,
+            "shaders/" + m_config.getShaderVariant()
+        );
+    }
+
+    // Picked once, the grid, the sorts and the compaction all scan the same way
+    ScanPath getScanPath() {
+        if (m_scanPath) {
+            return *m_scanPath;
+        }
+
+        bool subgroups = PrefixScan::supportsSubgroups(*m_deviceCtx);
+        if (m_config.scan == "subgroup" && !subgroups) {
+            throw std::runtime_error("the device has no subgroup arithmetic in compute shaders, use --scan shared!");
+        }
+
+        ScanPath path = m_config.scan != "shared" && subgroups ? ScanPath::Subgroup : ScanPath::Shared;
+        std::cout << "Prefix scan: " << (path == ScanPath::Subgroup ? "subgroup" : "shared memory") << "\n";
+        m_scanPath = path;
+        return path;
     }
 
     void createFramebuffers() {
@@ -856,7 +1353,9 @@ class ParticleSimulation {
     }
 
     void createCommandBuffers() {
-        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        m_graphicsCache = std::make_unique<CommandBufferCache>(*m_deviceCtx, m_deviceCtx->m_graphicsQueueCtx);
+
+        commandBuffers.resize(m_config.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -870,7 +1369,9 @@ class ParticleSimulation {
     }
     
     void createComputeCommandBuffers() {
-        m_computeCommandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+        m_computeCache = std::make_unique<CommandBufferCache>(*m_deviceCtx, m_deviceCtx->m_computeQueueCtx);
+
+        m_computeCommandBuffers.resize(m_config.framesInFlight);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -891,9 +1392,103 @@ class ParticleSimulation {
             throw std::runtime_error("failed to begin recording compute command buffer!");
         }
 
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
-        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1, &m_computeDescriptorSets[currentFrame], 0, nullptr);
-        vkCmdDispatch(commandBuffer, PARTICLE_COUNT / 256, 1, 1);
+        if (m_profiler) {
+            m_profiler->begin(commandBuffer, GpuPass::Compute, currentFrame);
+        }
+
+        // Earlier submissions may still be writing the buffers this one reads (or the scratch it reuses)
+        recordComputeBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+        uint64_t frameNumber = m_scheduler->getFrameNumber();
+
+        // The slot about to be written was handed to graphics once already, take it back
+        if (m_ownershipTransfers && frameNumber >= getSimulationSlotCount()) {
+            recordOwnershipTransfer(commandBuffer, m_simulationSlot, FrameQueue::Compute, true);
+        }
+
+        if (m_frameSubsteps == 0) {
+            recordCarryOver(commandBuffer);
+        } else {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+        }
+
+        for (uint32_t substep = 0; substep < m_frameSubsteps; substep++) {
+            // Odd/even from the end, so the last substep writes the frame's own buffers
+            bool writesCurrent = (m_frameSubsteps - 1 - substep) % 2 == 0;
+
+            ComputeRoute route;
+            if (substep == 0) {
+                route = writesCurrent ? PreviousToCurrent : PreviousToScratch;
+            } else {
+                route = writesCurrent ? ScratchToCurrent : CurrentToScratch;
+                recordComputeBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+            }
+
+            // Sorts (or compacts) the step's input into the sorted slot, which the step then reads instead
+            bool resorted = m_resortFrame && substep == 0;
+            if (m_grid) {
+                m_grid->recordBuild(commandBuffer, m_sortDescriptorSets[m_simulationSlot][route]);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+            }
+            if (resorted && m_reorder) {
+                m_reorder->recordReorder(commandBuffer, m_sortDescriptorSets[m_simulationSlot][route], currentFrame);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+            }
+            if (resorted && m_lifecycle) {
+                uint32_t inSlot = getRouteSlots(m_simulationSlot, route).first;
+                m_lifecycle->recordCompact(commandBuffer, m_sortDescriptorSets[m_simulationSlot][route], inSlot, getSortedSlot());
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+            }
+            if (m_tree) {
+                m_tree->recordBuild(commandBuffer, resorted ? m_resortedDescriptorSets[m_simulationSlot][route] : m_computeDescriptorSets[m_simulationSlot][route][0]);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+            }
+
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 1, 1, &m_stepParamsDescriptorSet, 1, &m_stepParamsOffsets[substep]);
+
+            // A single indirect dispatch over the live particles, then the emitters, so the next substep rebinds the kernel
+            if (m_lifecycle) {
+                std::pair<uint32_t, uint32_t> slots = getRouteSlots(m_simulationSlot, route);
+                if (resorted) {
+                    slots.first = getSortedSlot();
+                }
+
+                VkDescriptorSet particleSet = resorted ? m_resortedDescriptorSets[m_simulationSlot][route] : m_computeDescriptorSets[m_simulationSlot][route][0];
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1, &particleSet, 0, nullptr);
+                recordChunkFirst(commandBuffer, 0);
+                m_lifecycle->recordStep(commandBuffer, slots.first, slots.second);
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+                continue;
+            }
+
+            // One dispatch per chunk, the shaders bound check against the chunk's own length
+            for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+                VkDescriptorSet particleSet = resorted ? m_resortedDescriptorSets[m_simulationSlot][route] : m_computeDescriptorSets[m_simulationSlot][route][chunk];
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1, &particleSet, 0, nullptr);
+                recordChunkFirst(commandBuffer, m_particleChunks[chunk].firstParticle);
+                vkCmdDispatch(commandBuffer, getGroupCount(m_particleChunks[chunk].particleCount), 1, 1);
+            }
+        }
+
+        // Nothing reads the previous state after this frame, graphics draws it next
+        if (m_ownershipTransfers && frameNumber >= 1) {
+            uint32_t previous = (m_simulationSlot + getSimulationSlotCount() - 1) % getSimulationSlotCount();
+            recordOwnershipTransfer(commandBuffer, previous, FrameQueue::Graphics, false);
+        }
+
+        if (m_hashFrame) {
+            std::vector<uint32_t> chunkSizes;
+            for (const auto& chunk : m_particleChunks) {
+                chunkSizes.push_back(chunk.particleCount);
+            }
+
+            recordComputeBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+            m_hasher->recordHash(commandBuffer, m_hashDescriptorSets[m_simulationSlot], chunkSizes, currentFrame);
+        }
+
+        if (m_profiler) {
+            m_profiler->end(commandBuffer, GpuPass::Compute, currentFrame);
+        }
 
 
         if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
@@ -901,6 +1496,125 @@ class ParticleSimulation {
         }
     }
 
+    // Queue family ownership transfer of a slot's simulated streams, to the given queue. The same barriers
+    // are recorded twice, released on the old owner's queue and acquired on the new one's, with the
+    // semaphore wait between the two submissions ordering them.
+    // Compute releases a state once the next frame is done reading it and graphics releases it after drawing
+    void recordOwnershipTransfer(VkCommandBuffer commandBuffer, uint32_t slot, FrameQueue to, bool acquire) {
+        uint32_t computeFamily = m_deviceCtx->m_computeQueueCtx.queueFamilyIndex;
+        uint32_t graphicsFamily = m_deviceCtx->m_graphicsQueueCtx.queueFamilyIndex;
+        bool toGraphics = to == FrameQueue::Graphics;
+
+        // Only one side of the barrier counts, the stage and access of the other queue are ignored
+        VkPipelineStageFlags computeStages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        VkAccessFlags srcAccess = 0;
+        VkAccessFlags dstAccess = 0;
+
+        if (acquire && toGraphics) {
+            dstStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+            dstAccess = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        } else if (acquire) {
+            dstStage = computeStages;
+            dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        } else if (toGraphics) {
+            srcStage = computeStages;
+            srcAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        } else {
+            srcStage = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+        }
+
+        std::vector<VkBufferMemoryBarrier> barriers;
+        for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+            for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+                if (!m_particleStreams[stream].simulated) {
+                    continue;
+                }
+
+                VkBufferMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = srcAccess;
+                barrier.dstAccessMask = dstAccess;
+                barrier.srcQueueFamilyIndex = toGraphics ? computeFamily : graphicsFamily;
+                barrier.dstQueueFamilyIndex = toGraphics ? graphicsFamily : computeFamily;
+                barrier.buffer = m_shaderStorageBuffers[slot][chunk][stream]->m_vkBuffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                barriers.push_back(barrier);
+            }
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            srcStage, dstStage,
+            0, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data(), 0, nullptr
+        );
+    }
+
+    void recordComputeBarrier(VkCommandBuffer commandBuffer, VkAccessFlags srcAccess, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr
+        );
+    }
+
+    // The helpers' own layouts throw away the push constants, so every step dispatch sets it again
+    void recordChunkFirst(VkCommandBuffer commandBuffer, uint32_t firstParticle) {
+        vkCmdPushConstants(commandBuffer, m_computePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &firstParticle);
+    }
+
+    // A frame the accumulator gave no steps still draws from its own buffers, so they get the previous state
+    void recordCarryOver(VkCommandBuffer commandBuffer) {
+        uint32_t previous = (m_simulationSlot + getSimulationSlotCount() - 1) % getSimulationSlotCount();
+
+        for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+            for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+                if (!m_particleStreams[stream].simulated) {
+                    continue;
+                }
+
+                const GpuBuffer& src = *m_shaderStorageBuffers[previous][chunk][stream];
+                const GpuBuffer& dst = *m_shaderStorageBuffers[m_simulationSlot][chunk][stream];
+
+                VkBufferCopy copyRegion{};
+                copyRegion.size = src.m_size;
+                vkCmdCopyBuffer(commandBuffer, src.m_vkBuffer, dst.m_vkBuffer, 1, &copyRegion);
+            }
+        }
+
+        if (m_lifecycle) {
+            m_lifecycle->recordCarryOver(commandBuffer, previous, m_simulationSlot);
+        }
+    }
+
+    // Fixed timestep: the last frame's time goes into the accumulator and comes out as whole steps
+    uint32_t takeFrameSubsteps() {
+        if (m_config.stepRate <= 0.0f) {
+            return m_config.substeps;
+        }
+
+        double stepSeconds = 1.0 / m_config.stepRate;
+        m_stepAccumulator += lastFrameTime / 1000.0;
+
+        uint32_t substeps = static_cast<uint32_t>(m_stepAccumulator / stepSeconds);
+        if (substeps > m_config.maxSubsteps) {
+            // Can't keep up, drop the backlog instead of spiraling
+            substeps = m_config.maxSubsteps;
+            m_stepAccumulator = 0.0;
+        } else {
+            m_stepAccumulator -= substeps * stepSeconds;
+        }
+
+        return substeps;
+    }
+
     void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
         VkCommandBufferBeginInfo beginInfo{};
         beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -921,6 +1635,14 @@ class ParticleSimulation {
         renderPassInfo.clearValueCount = 1;
         renderPassInfo.pClearValues = &clearColor;
 
+        if (m_profiler) {
+            m_profiler->begin(commandBuffer, GpuPass::Graphics, currentFrame);
+        }
+
+        if (m_ownershipTransfers && m_hasRenderState) {
+            recordOwnershipTransfer(commandBuffer, m_renderSlot, FrameQueue::Graphics, true);
+        }
+
         // Begin render pass
         vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
         
@@ -940,142 +1662,315 @@ class ParticleSimulation {
         scissor.extent = swapChainExtent;
         vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-        VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_shaderStorageBuffers[currentFrame]->m_vkBuffer, offsets);
-        
-        vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
+        // Stream i is bound at vertex binding i
+        std::vector<VkBuffer> vertexBuffers(m_particleStreams.size());
+        std::vector<VkDeviceSize> offsets(m_particleStreams.size(), 0);
+        for (size_t chunk = 0; m_hasRenderState && chunk < m_particleChunks.size(); chunk++) {
+            for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+                vertexBuffers[stream] = m_shaderStorageBuffers[m_renderSlot][chunk][stream]->m_vkBuffer;
+            }
+
+            vkCmdBindVertexBuffers(commandBuffer, 0, static_cast<uint32_t>(vertexBuffers.size()), vertexBuffers.data(), offsets.data());
+
+            // Only the live particles, through the slot's list
+            if (m_lifecycle) {
+                m_lifecycle->recordDraw(commandBuffer, m_renderSlot);
+            } else {
+                vkCmdDraw(commandBuffer, m_particleChunks[chunk].particleCount, 1, 0, 0);
+            }
+        }
 
         // End render pass
         vkCmdEndRenderPass(commandBuffer);
 
-        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("failed to record command buffer!");
+        if (m_ownershipTransfers && m_hasRenderState) {
+            recordOwnershipTransfer(commandBuffer, m_renderSlot, FrameQueue::Compute, false);
         }
 
-    }
+        if (m_profiler) {
+            m_profiler->end(commandBuffer, GpuPass::Graphics, currentFrame);
+        }
 
-    void createSyncObjects() {
-        VkDevice logicalDevice = m_deviceCtx->m_logicalDevice;
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
+        }
+
+    }
 
-        m_computeInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-        m_computeFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    // Takes the render slot and hands it straight back, for frames that don't draw
+    void recordSkippedFrame(VkCommandBuffer commandBuffer) {
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-        VkSemaphoreCreateInfo computeSemaphoreInfo{};
-        computeSemaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording command buffer!");
+        }
 
-        VkFenceCreateInfo computeFenceInfo{};
-        computeFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        computeFenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        recordOwnershipTransfer(commandBuffer, m_renderSlot, FrameQueue::Graphics, true);
+        recordOwnershipTransfer(commandBuffer, m_renderSlot, FrameQueue::Compute, false);
 
-        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            if (vkCreateSemaphore(logicalDevice, &computeSemaphoreInfo, nullptr, &m_computeFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(logicalDevice, &computeFenceInfo, nullptr, &m_computeInFlightFences[i]) != VK_SUCCESS) {
-                throw std::runtime_error("failed to create compute synchronization objects for a frame!");
-            }
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record command buffer!");
         }
+    }
 
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+    void createSyncObjects() {
+        VkDevice logicalDevice = m_deviceCtx->m_logicalDevice;
+
+        m_scheduler = std::make_unique<FrameScheduler>(*m_deviceCtx, m_config.framesInFlight);
+
+        imageAvailableSemaphores.resize(m_config.framesInFlight);
+        renderFinishedSemaphores.resize(m_config.framesInFlight);
 
         VkSemaphoreCreateInfo semaphoreInfo{};
         semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Create the fence in signaled state, so the first call of drawFrame() will occur
-
-        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (uint32_t i = 0; i < m_config.framesInFlight; i++) {
             if (vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-                vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-                vkCreateFence(logicalDevice, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+                vkCreateSemaphore(logicalDevice, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS) {
                 throw std::runtime_error("failed to create semaphores!");
             }
         }
+    }
 
+    uint32_t getGroupCount(uint32_t particleCount) {
+        return (particleCount + m_config.workgroupSize - 1) / m_config.workgroupSize;
     }
 
-    void createUniformBuffers() {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-        VkDeviceSize rngBufferSize = sizeof(rngUbo);
+    // Splits the particle set so no single SSBO goes past what the device can bind or allocate
+    void createParticleChunks() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_deviceCtx->m_physicalDevice, &properties);
 
-        m_uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        m_rngUbo.resize(MAX_FRAMES_IN_FLIGHT);
-        
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            m_uniformBuffers[i] = std::make_unique<GpuBuffer>(
-                *m_deviceCtx,
-                bufferSize,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_deviceCtx->m_graphicsQueueCtx
-            );
+        uint32_t maxStride = 0;
+        for (const auto& stream : m_particleStreams) {
+            maxStride = std::max(maxStride, stream.stride);
+        }
 
-            m_rngUbo[i] = std::make_unique<GpuBuffer>(
-                *m_deviceCtx,
-                rngBufferSize,
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                m_deviceCtx->m_computeQueueCtx
-            );
+        VkDeviceSize maxChunkParticles = m_deviceCtx->getMaxStorageBufferRange() / maxStride;
+
+        // A single dispatch can't go past the workgroup count limit either
+        maxChunkParticles = std::min<VkDeviceSize>(
+            maxChunkParticles,
+            static_cast<VkDeviceSize>(properties.limits.maxComputeWorkGroupCount[0]) * m_config.workgroupSize
+        );
+
+        if (m_config.maxChunkParticles != 0) {
+            maxChunkParticles = std::min<VkDeviceSize>(maxChunkParticles, m_config.maxChunkParticles);
         }
+
+        // Keep chunk boundaries aligned to whole workgroups
+        maxChunkParticles -= maxChunkParticles % m_config.workgroupSize;
+        if (maxChunkParticles == 0) {
+            throw std::runtime_error("particle chunk size is smaller than a compute workgroup!");
+        }
+
+        m_particleChunks.clear();
+        for (uint32_t first = 0; first < m_config.particleCount;) {
+            uint32_t count = static_cast<uint32_t>(std::min<VkDeviceSize>(maxChunkParticles, m_config.particleCount - first));
+            m_particleChunks.push_back({ first, count });
+            first += count;
+        }
+
+        std::cout << "Particles: " << m_config.particleCount << " in " << m_particleChunks.size() << " chunk(s) of up to " << maxChunkParticles << "\n";
+
+        if (m_config.needsSingleChunk() && m_particleChunks.size() > 1) {
+            std::string user = m_grid ? "grid" : m_config.isNBody() || m_config.usesLifecycle() ? m_config.kernel + " kernel" : "Morton re-sort";
+            throw std::runtime_error("the " + user + " needs every particle in a single chunk!");
+        }
+    }
+
+    // Frame N simulates into slot N % count reading the slot before it, and draws the slot of frame
+    // N - getRenderLag(). Always one more than the lag so compute never writes what graphics is drawing
+    uint32_t getSimulationSlotCount() {
+        return std::max<uint32_t>(m_config.framesInFlight, getRenderLag() + 1);
+    }
+
+    // Frames between computing a state and drawing it. Double buffering draws the previous frame's state,
+    // which compute is reading at the same time. Triple buffering waits until compute is done reading it too
+    uint32_t getRenderLag() {
+        return m_config.tripleBuffering ? 2 : 1;
+    }
+
+    bool isRendering() {
+        return !m_config.headless || m_config.render;
+    }
+
+    bool hasSeparateComputeFamily() {
+        return m_deviceCtx->m_computeQueueCtx.queueFamilyIndex != m_deviceCtx->m_graphicsQueueCtx.queueFamilyIndex;
+    }
+
+    uint32_t getScratchSlot() {
+        return getSimulationSlotCount();
+    }
+
+    uint32_t getSortedSlot() {
+        return getScratchSlot() + (m_config.getMaxSubsteps() > 1 ? 1 : 0);
+    }
+
+    uint32_t getStorageSlotCount() {
+        return getSortedSlot() + (usesSortedSlot() ? 1 : 0);
+    }
+
+    bool isCompacting() {
+        return m_lifecycle && m_config.compactInterval > 0;
+    }
+
+    // The Morton re-sort or the compaction, every few frames before the first substep
+    bool usesResort() {
+        return m_reorder || isCompacting();
+    }
+
+    bool usesSortedSlot() {
+        return m_grid || usesResort();
     }
 
     void createShaderStorageBuffers() {
-        m_shaderStorageBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-        for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            m_shaderStorageBuffers[i] = std::make_unique<GpuBuffer>(
-                *m_deviceCtx,
-                sizeof(Particle) * PARTICLE_COUNT,
-                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                m_deviceCtx->m_computeQueueCtx
-            );
+        m_ownershipTransfers = m_config.tripleBuffering && isRendering() && hasSeparateComputeFamily();
+
+        // Double buffering has both queues reading the same state, no single owner possible
+        std::vector<uint32_t> sharedFamilies;
+        if (!m_config.tripleBuffering && isRendering()) {
+            sharedFamilies = {
+                m_deviceCtx->m_computeQueueCtx.queueFamilyIndex,
+                m_deviceCtx->m_graphicsQueueCtx.queueFamilyIndex
+            };
+        }
+
+        m_shaderStorageBuffers.assign(getStorageSlotCount(), std::vector<std::vector<std::shared_ptr<GpuBuffer>>>(m_particleChunks.size()));
+
+        for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+            for (const auto& stream : m_particleStreams) {
+                for (uint32_t i = 0; i < getStorageSlotCount(); i++) {
+                    // Spawn only streams are never written by the kernels, one copy does for every frame
+                    if (!stream.simulated && i > 0) {
+                        m_shaderStorageBuffers[i][chunk].push_back(m_shaderStorageBuffers[0][chunk].back());
+                        continue;
+                    }
+
+                    // Spawn only streams are only ever drawn, so they live on the graphics queue
+                    m_shaderStorageBuffers[i][chunk].push_back(std::make_shared<GpuBuffer>(
+                        *m_deviceCtx,
+                        static_cast<VkDeviceSize>(stream.stride) * m_particleChunks[chunk].particleCount,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                        stream.simulated ? m_deviceCtx->m_computeQueueCtx : m_deviceCtx->m_graphicsQueueCtx,
+                        stream.simulated && i < getSimulationSlotCount() ? sharedFamilies : std::vector<uint32_t>{}
+                    ));
+                }
+            }
         }
     }
 
+    // Generated straight into the staging ring, a piece of a stream at a time split across the initializer's
+    // threads, and copied from there into every slot that starts with it
     void initialiazeParticles() {
-        std::vector<Particle> particles(PARTICLE_COUNT);
-        for (auto& particle : particles) {
-            // Random position
-            float x = (getRandomFloat() * 2.0f) - 1.0f;
-            float y = (getRandomFloat() * 2.0f) - 1.0f;
-            particle.position = glm::vec2(x, y);
-                
-            // Random angle for direction
-            float theta = getRandomFloat() * 2.0f * 3.14159265f;
-            
-            // Calculate velocity independent of position
-            float velX = cos(theta);
-            float velY = sin(theta);
-            
-            // Set velocity using the angle
-            particle.velocity = glm::normalize(glm::vec2(velX, velY)) * 0.0025f;
+        auto start = std::chrono::steady_clock::now();
+
+        ParticleInitializer initializer(m_seed, m_config.layout, m_config.encoding, m_config.mass);
+        StagingRing& stagingRing = *m_deviceCtx->m_stagingRing;
+
+        for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+            for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+                VkDeviceSize stride = m_particleStreams[stream].stride;
+                uint32_t pieceParticles = static_cast<uint32_t>(stagingRing.getMaxAllocationSize() / stride);
 
-            // Random color :b
-            particle.color = glm::vec4(getRandomFloat(), getRandomFloat(), getRandomFloat(), 1.0f);
+                // Lifecycle steps carry a respawned particle's color over from whatever slot they read, scratch included
+                uint32_t copies = !m_particleStreams[stream].simulated ? 1 : m_lifecycle ? getSortedSlot() : getSimulationSlotCount();
+                const QueueContext& queueCtx = m_shaderStorageBuffers[0][chunk][stream]->m_queueCtx;
+
+                for (uint32_t first = 0; first < m_particleChunks[chunk].particleCount; first += pieceParticles) {
+                    uint32_t count = std::min(pieceParticles, m_particleChunks[chunk].particleCount - first);
+
+                    StagingAllocation allocation = stagingRing.allocate(stride * count, queueCtx);
+                    initializer.generate(stream, m_particleChunks[chunk].firstParticle + first, count, allocation.data);
+
+                    for (uint32_t i = 0; i < copies; i++) {
+                        stagingRing.copyToBuffer(allocation, m_shaderStorageBuffers[i][chunk][stream]->m_vkBuffer, stride * first);
+                    }
+                }
+            }
         }
 
-        VkDeviceSize totalDataSize = sizeof(Particle) * PARTICLE_COUNT;
-        for (uint32_t i = 0;  i < MAX_FRAMES_IN_FLIGHT; i++) {
-            m_shaderStorageBuffers[i]->copyFromCpu(particles.data(), totalDataSize);
+        // Everyone starts alive at a random point of their life, so deaths are spread out from the start
+        if (m_lifecycle) {
+            std::vector<glm::vec2> lifetimes(m_config.particleCount);
+            for (uint32_t i = 0; i < m_config.particleCount; i++) {
+                glm::vec4 random = CounterRng::unit(m_seed, CounterRng::Initialize, i, 0, 2);
+                lifetimes[i].y = m_config.lifetime * (0.75f + 0.5f * random.x);
+                lifetimes[i].x = lifetimes[i].y * random.y;
+            }
+            m_lifecycle->initialize(lifetimes, getSimulationSlotCount());
+        }
+
+        // Submits whatever the ring didn't have to submit on its own already, ordered before the first compute dispatch
+        stagingRing.flush();
+
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Initialized " << m_config.particleCount << " particles in " << ms << " ms on "
+                  << initializer.getThreadCount() << " thread(s)" << (ParticleInitializer::hasAvx2() ? ", AVX2" : "") << "\n";
+    }
+
+    // Room for every substep a frame can run, each one at its own aligned offset
+    void createStepParams() {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(m_deviceCtx->m_physicalDevice, &properties);
+
+        VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+        VkDeviceSize stride = (sizeof(SimulationParams) + alignment - 1) / alignment * alignment;
+
+        m_stepParams = std::make_unique<UniformRing>(*m_deviceCtx, m_config.framesInFlight, stride * m_config.getMaxSubsteps());
+    }
+
+    // Slots a route of the given simulation slot reads and writes
+    std::pair<uint32_t, uint32_t> getRouteSlots(uint32_t slot, ComputeRoute route) {
+        uint32_t previous = (slot + getSimulationSlotCount() - 1) % getSimulationSlotCount();
+        uint32_t scratch = getScratchSlot();
+
+        switch (route) {
+            case PreviousToScratch:
+                return { previous, scratch };
+            case ScratchToCurrent:
+                return { scratch, slot };
+            case CurrentToScratch:
+                return { slot, scratch };
+            default:
+                return { previous, slot };
         }
     }
 
+    uint32_t getComputeRouteCount() {
+        return m_config.getMaxSubsteps() > 1 ? static_cast<uint32_t>(COMPUTE_ROUTE_COUNT) : 1;
+    }
+
     void createDescriptorPool() {
-        std::array<VkDescriptorPoolSize, 3> poolSizes{};
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-        poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) * 2;
-        poolSizes[2].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        uint32_t setCount = static_cast<uint32_t>(getSimulationSlotCount() * getComputeRouteCount() * m_particleChunks.size());
+        if (usesSortedSlot()) {
+            setCount += getSimulationSlotCount() * getComputeRouteCount();
+        }
+        if (usesResort()) {
+            setCount += getSimulationSlotCount() * getComputeRouteCount();
+        }
+        if (m_hasher) {
+            setCount += static_cast<uint32_t>(getSimulationSlotCount() * m_particleChunks.size());
+        }
+
+        uint32_t simulatedStreams = 0;
+        for (const auto& stream : m_particleStreams) {
+            simulatedStreams += stream.simulated ? 1 : 0;
+        }
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        poolSizes[0].descriptorCount = setCount * 2 * simulatedStreams;
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[1].descriptorCount = 1;
 
         VkDescriptorPoolCreateInfo poolInfo{};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        poolInfo.maxSets = setCount + 1;
 
         if (vkCreateDescriptorPool(m_deviceCtx->m_logicalDevice, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
             throw std::runtime_error("failed to create descriptor pool!");
@@ -1083,109 +1978,266 @@ class ParticleSimulation {
     }
 
     void createDescriptorSets() {
-        std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, m_computeDescriptorSetLayout);
+        VkDescriptorSetAllocateInfo paramsAllocInfo{};
+        paramsAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        paramsAllocInfo.descriptorPool = descriptorPool;
+        paramsAllocInfo.descriptorSetCount = 1;
+        paramsAllocInfo.pSetLayouts = &m_stepParamsDescriptorSetLayout;
+
+        if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &paramsAllocInfo, &m_stepParamsDescriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate descriptor sets!");
+        }
+
+        DescriptorWriter paramsWriter;
+        paramsWriter.addDynamicUniformBufferBinding(m_stepParamsDescriptorSet, 0, m_stepParams->getBuffer(), sizeof(SimulationParams));
+        paramsWriter.writeAll(m_deviceCtx->m_logicalDevice);
+
+        std::vector<VkDescriptorSetLayout> layouts(m_particleChunks.size(), m_computeDescriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = descriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+        allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
         allocInfo.pSetLayouts = layouts.data();
 
-        m_computeDescriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+        // Binds the simulated streams of the slots as the kernels' in/out pair
+        auto writeParticleSet = [&](VkDescriptorSet set, size_t chunk, uint32_t inSlot, uint32_t outSlot) {
+            DescriptorWriter writer;
 
-        if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &allocInfo, m_computeDescriptorSets.data()) != VK_SUCCESS) {
-            throw std::runtime_error("failed to allocate descriptor sets!");
+            for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+                if (!m_particleStreams[stream].simulated) {
+                    continue;
+                }
+
+                writer.addStorageBufferBinding(set, m_particleStreams[stream].inBinding, *m_shaderStorageBuffers[inSlot][chunk][stream], 1);
+                writer.addStorageBufferBinding(set, m_particleStreams[stream].outBinding, *m_shaderStorageBuffers[outSlot][chunk][stream], 1);
+            }
+
+            writer.writeAll(m_deviceCtx->m_logicalDevice);
+        };
+
+        m_computeDescriptorSets.assign(getSimulationSlotCount(), std::vector<std::vector<VkDescriptorSet>>(getComputeRouteCount()));
+        m_sortDescriptorSets.assign(usesSortedSlot() ? getSimulationSlotCount() : 0, std::vector<VkDescriptorSet>(getComputeRouteCount()));
+        m_resortedDescriptorSets.assign(usesResort() ? getSimulationSlotCount() : 0, std::vector<VkDescriptorSet>(getComputeRouteCount()));
+
+        for (uint32_t i = 0; i < getSimulationSlotCount(); i++) {
+            // Slots read and written, per ComputeRoute
+            std::array<std::pair<uint32_t, uint32_t>, COMPUTE_ROUTE_COUNT> routeSlots;
+            for (uint32_t route = 0; route < COMPUTE_ROUTE_COUNT; route++) {
+                routeSlots[route] = getRouteSlots(i, static_cast<ComputeRoute>(route));
+            }
+
+            for (uint32_t route = 0; route < getComputeRouteCount(); route++) {
+                m_computeDescriptorSets[i][route].resize(m_particleChunks.size());
+
+                if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &allocInfo, m_computeDescriptorSets[i][route].data()) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to allocate descriptor sets!");
+                }
+
+                uint32_t inSlot = m_grid ? getSortedSlot() : routeSlots[route].first;
+                for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+                    writeParticleSet(m_computeDescriptorSets[i][route][chunk], chunk, inSlot, routeSlots[route].second);
+                }
+
+                if (usesSortedSlot()) {
+                    if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &allocInfo, &m_sortDescriptorSets[i][route]) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to allocate descriptor sets!");
+                    }
+                    writeParticleSet(m_sortDescriptorSets[i][route], 0, routeSlots[route].first, getSortedSlot());
+                }
+
+                // Only the first substep's routes ever follow a re-sort, the others are never bound
+                if (usesResort()) {
+                    if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &allocInfo, &m_resortedDescriptorSets[i][route]) != VK_SUCCESS) {
+                        throw std::runtime_error("failed to allocate descriptor sets!");
+                    }
+                    writeParticleSet(m_resortedDescriptorSets[i][route], 0, getSortedSlot(), routeSlots[route].second);
+                }
+            }
         }
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            DescriptorWriter writer;
-            
-            writer.addUniformBufferBinding(
-                m_computeDescriptorSets[i],
-                0,  *m_uniformBuffers[i]
-            );
-            
-            writer.addStorageBufferBinding(
-                m_computeDescriptorSets[i],
-                1, *m_shaderStorageBuffers[((i - 1) % MAX_FRAMES_IN_FLIGHT)],
-                1
-            );
+        // The hash only reads the in side, which is the slot itself
+        m_hashDescriptorSets.assign(m_hasher ? getSimulationSlotCount() : 0, std::vector<VkDescriptorSet>(m_particleChunks.size()));
+        for (uint32_t i = 0; i < m_hashDescriptorSets.size(); i++) {
+            if (vkAllocateDescriptorSets(m_deviceCtx->m_logicalDevice, &allocInfo, m_hashDescriptorSets[i].data()) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate descriptor sets!");
+            }
+            for (size_t chunk = 0; chunk < m_particleChunks.size(); chunk++) {
+                writeParticleSet(m_hashDescriptorSets[i][chunk], chunk, i, i);
+            }
+        }
+    }
 
-            writer.addStorageBufferBinding(
-                m_computeDescriptorSets[i],
-                2, *m_shaderStorageBuffers[i],
-                1
-            );
+    // Every frame starts here: picks the frame's slots, waits until its command buffer is free again
+    // and submits the compute work. Graphics is only waited on when some graphics work is going to run
+    void submitCompute(bool rendering) {
+        uint64_t frameNumber = m_scheduler->getFrameNumber();
+        currentFrame = m_scheduler->getFrameSlot();
+        m_simulationSlot = static_cast<uint32_t>(frameNumber % getSimulationSlotCount());
 
-            writer.addUniformBufferBinding(
-                m_computeDescriptorSets[i],
-                3,  *m_rngUbo[i]
-            );
+        m_hasRenderState = frameNumber >= getRenderLag();
+        m_renderSlot = static_cast<uint32_t>((frameNumber + getSimulationSlotCount() - getRenderLag()) % getSimulationSlotCount());
 
-            writer.writeAll(m_deviceCtx->m_logicalDevice);
+        m_scheduler->waitForSlot(FrameQueue::Compute);
+        if (m_profiler) {
+            m_profiler->collect(GpuPass::Compute, currentFrame);
+        }
+        if (m_reorder) {
+            m_reorder->collect(currentFrame);
+        }
+        if (m_hasher) {
+            m_hasher->collect(currentFrame);
+        }
+
+        m_frameSubsteps = takeFrameSubsteps();
+        uint32_t stepsBefore = m_stepIndex;
+        writeStepParams();
+
+        // Hashes land on the frame whose steps reach the next multiple of the interval
+        m_hashFrame = m_hasher && m_stepIndex / m_config.hashInterval > stepsBefore / m_config.hashInterval;
+
+        // Frames without a step have nothing to sort into, the next one with a step waits for the next interval
+        uint32_t resortInterval = m_reorder ? m_config.mortonSortInterval : m_config.compactInterval;
+        m_resortFrame = usesResort() && m_frameSubsteps > 0 && frameNumber > 0 && frameNumber % resortInterval == 0;
+
+        VkCommandBuffer commandBuffer = getComputeCommandBuffer();
+
+        // The slot about to be overwritten was last drawn by frame N - slot count + lag, compute can
+        // run that far ahead of graphics without the CPU waiting on anything
+        std::vector<SubmitWait> waits;
+        if (rendering && frameNumber >= getSimulationSlotCount()) {
+            waits.push_back({
+                m_scheduler->getTimeline(FrameQueue::Graphics),
+                m_scheduler->getFrameValue(frameNumber - getSimulationSlotCount() + getRenderLag()),
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT
+            });
+        }
+
+        m_scheduler->submit(FrameQueue::Compute, commandBuffer, waits);
+        if (m_profiler) {
+            m_profiler->submitted(GpuPass::Compute, currentFrame);
+        }
+        if (m_resortFrame && m_reorder) {
+            m_reorder->submitted(currentFrame);
+        }
+        if (m_hashFrame) {
+            m_hasher->submitted(currentFrame, m_stepIndex);
         }
     }
 
-    void drawFrame() {
-        // Compute submission
-        vkWaitForFences(m_deviceCtx->m_logicalDevice, 1, &m_computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-        updateUniformBuffers(currentFrame);
+    // Until every simulation slot was written once the frames record one-off ownership barriers,
+    // from then on a frame's command buffers only depend on its slots, substeps, re-sort and swap chain image
+    bool isSteadyState() {
+        return m_scheduler->getFrameNumber() >= getSimulationSlotCount();
+    }
 
-        vkResetFences(m_deviceCtx->m_logicalDevice, 1, &m_computeInFlightFences[currentFrame]);
-        
-        vkResetCommandBuffer(m_computeCommandBuffers[currentFrame], 0);
-        recordComputeCommandBuffer(m_computeCommandBuffers[currentFrame]);
+    VkCommandBuffer getComputeCommandBuffer() {
+        if (!isSteadyState()) {
+            vkResetCommandBuffer(m_computeCommandBuffers[currentFrame], 0);
+            recordComputeCommandBuffer(m_computeCommandBuffers[currentFrame]);
+            return m_computeCommandBuffers[currentFrame];
+        }
+
+        // Frame and SSBO slot a byte each (both at most a handful), the per frame flags, then the substeps with
+        // 32 bits to themselves (SimulationConfig::MAX_SUBSTEPS keeps them far from that anyway)
+        uint64_t key = currentFrame | (static_cast<uint64_t>(m_simulationSlot) << 8)
+            | (static_cast<uint64_t>(m_resortFrame) << 16) | (static_cast<uint64_t>(m_hashFrame) << 17)
+            | (static_cast<uint64_t>(m_frameSubsteps) << 32);
+        return m_computeCache->get(key, [this](VkCommandBuffer commandBuffer) {
+            recordComputeCommandBuffer(commandBuffer);
+        });
+    }
+
+    VkCommandBuffer getGraphicsCommandBuffer(uint32_t imageIndex) {
+        if (!isSteadyState()) {
+            vkResetCommandBuffer(commandBuffers[currentFrame], 0);
+            recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+            return commandBuffers[currentFrame];
+        }
+
+        uint64_t key = currentFrame | (static_cast<uint64_t>(m_renderSlot) << 8) | (static_cast<uint64_t>(imageIndex) << 16);
+        return m_graphicsCache->get(key, [this, imageIndex](VkCommandBuffer commandBuffer) {
+            recordCommandBuffer(commandBuffer, imageIndex);
+        });
+    }
 
-        VkSubmitInfo computeSubmitInfo{};
-        computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    void submitGraphics(VkCommandBuffer commandBuffer, const std::vector<SubmitWait>& waits, const std::vector<VkSemaphore>& binarySignals = {}) {
+        m_scheduler->submit(FrameQueue::Graphics, commandBuffer, waits, binarySignals);
+        if (m_profiler) {
+            m_profiler->submitted(GpuPass::Graphics, currentFrame);
+        }
+    }
+
+    // Graphics only waits for the previous frame's compute, which the last frame's graphics already
+    // waited for, so this frame's compute and graphics run side by side. With triple buffering that
+    // compute is also the one releasing the state drawn
+    std::vector<SubmitWait> getComputeDoneWaits() {
+        uint64_t frameNumber = m_scheduler->getFrameNumber();
+        if (frameNumber == 0) {
+            return {};
+        }
 
-        computeSubmitInfo.commandBufferCount = 1;
-        computeSubmitInfo.pCommandBuffers = &m_computeCommandBuffers[currentFrame];
-        computeSubmitInfo.signalSemaphoreCount = 1;
-        computeSubmitInfo.pSignalSemaphores = &m_computeFinishedSemaphores[currentFrame];
+        return {{
+            m_scheduler->getTimeline(FrameQueue::Compute),
+            m_scheduler->getFrameValue(frameNumber - 1),
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        }};
+    }
+
+    // Headless counterpart of drawFrame, nothing to acquire or present and the
+    // graphics work only runs when rendering offscreen was asked for
+    void drawOffscreenFrame() {
+        submitCompute(m_config.render);
+
+        if (m_config.render) {
+            m_scheduler->waitForSlot(FrameQueue::Graphics);
+            if (m_profiler) {
+                m_profiler->collect(GpuPass::Graphics, currentFrame);
+            }
 
-        // Submit compute command
-        if (vkQueueSubmit(m_deviceCtx->m_computeQueueCtx.queue, 1, &computeSubmitInfo, m_computeInFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit compute command buffer!");
+            submitGraphics(getGraphicsCommandBuffer(0), getComputeDoneWaits());
         }
+    }
+
+    void drawFrame() {
+        // Compute submission
+        submitCompute(true);
 
         // Graphics submission
-        vkWaitForFences(m_deviceCtx->m_logicalDevice, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+        m_scheduler->waitForSlot(FrameQueue::Graphics);
+        if (m_profiler) {
+            m_profiler->collect(GpuPass::Graphics, currentFrame);
+        }
 
         uint32_t imageIndex;
         VkResult result = vkAcquireNextImageKHR(m_deviceCtx->m_logicalDevice, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
            
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
             recreateSwapChain();
+
+            // Later compute waits on this frame's graphics value, so it still has to be signaled,
+            // and the state it would have drawn still has to go back to compute
+            VkCommandBuffer skipped = VK_NULL_HANDLE;
+            if (m_ownershipTransfers && m_hasRenderState) {
+                skipped = commandBuffers[currentFrame];
+                vkResetCommandBuffer(skipped, 0);
+                recordSkippedFrame(skipped);
+            }
+
+            m_scheduler->submit(FrameQueue::Graphics, skipped, getComputeDoneWaits());
             return;
         } else if (result != VK_SUCCESS) {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
 
-        vkResetFences(m_deviceCtx->m_logicalDevice, 1, &inFlightFences[currentFrame]);
-
-        vkResetCommandBuffer(commandBuffers[currentFrame], 0);
-        recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
-        
-        VkSubmitInfo submitInfo{};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        
-        VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-        VkSemaphore waitSemaphores[] = { m_computeFinishedSemaphores[currentFrame], imageAvailableSemaphores[currentFrame] };
-        submitInfo.waitSemaphoreCount = 2;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
-
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+        VkCommandBuffer commandBuffer = getGraphicsCommandBuffer(imageIndex);
 
         VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
-        submitInfo.signalSemaphoreCount = 1;
-        submitInfo.pSignalSemaphores = signalSemaphores;
+
+        std::vector<SubmitWait> waits = getComputeDoneWaits();
+        waits.push_back({ imageAvailableSemaphores[currentFrame], 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT });
 
         // Submit graphics command
-        if (vkQueueSubmit(m_deviceCtx->m_graphicsQueueCtx.queue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to submit draw command buffer!");
-        }
+        submitGraphics(commandBuffer, waits, { renderFinishedSemaphores[currentFrame] });
 
         VkPresentInfoKHR presentInfo{};
         presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1208,31 +2260,423 @@ class ParticleSimulation {
         } else if (result != VK_SUCCESS) {
             throw std::runtime_error("failed to acquire swap chain image!");
         }
+    }
+
+    // Called once per frame, before the compute command buffer is recorded or picked from the cache.
+    // The offsets only depend on the frame slot and the substep, so cached command buffers stay valid.
+    // Physics comes from m_physics every step, so changing it while running takes effect right away
+    void writeStepParams() {
+        m_stepParams->beginFrame(currentFrame);
+        m_stepParamsOffsets.clear();
+
+        for (uint32_t substep = 0; substep < m_frameSubsteps; substep++) {
+            SimulationParams params = getStepParams();
+            params.stepIndex = m_stepIndex++;
+            params.emitCount = takeEmitCount();
+
+            m_stepParamsOffsets.push_back(m_stepParams->push(params));
+        }
+    }
+
+    // Whole particles the emitters owe for one more step
+    uint32_t takeEmitCount() {
+        if (!m_lifecycle) {
+            return 0;
+        }
+
+        m_emitAccumulator += static_cast<double>(m_config.getEmitRate()) * m_config.deltaTime;
+        uint32_t count = static_cast<uint32_t>(m_emitAccumulator);
+        m_emitAccumulator -= count;
+        return count;
+    }
+
+    // Everything but the step index and emit count
+    SimulationParams getStepParams() {
+        SimulationParams params{};
+        params.deltaTime = m_config.deltaTime;
+        params.seed = m_seed;
+
+        params.gravity = m_physics.gravity;
+        params.airResist = m_physics.airResist;
+        params.resetSpeedThreshold = m_physics.resetSpeedThreshold;
+        params.launchStrength = m_physics.launchStrength;
+        // The grid cells were sized for the starting radius, a larger disc would reach past the 3x3 cells searched
+        params.particleRadius = m_grid ? std::min(m_physics.particleRadius, m_grid->getCellSize() / 2.0f) : m_physics.particleRadius;
+        params.restitution = m_physics.restitution;
+        params.attraction = m_physics.attraction;
+        params.softening = m_physics.softening;
+        params.openingAngle = m_physics.openingAngle;
+
+        // Only the aos layouts bind the color to the kernels
+        params.useMass = m_config.mass && m_config.layout == ParticleLayout::AoS ? 1 : 0;
+        return params;
+    }
+
+    // Runs one step of the kernel on the GPU, outside of the frame loop, and checks a sample of the
+    // particles against the kernel's CPU reference. The step's output is overwritten by the first frame.
+    // Barnes-Hut is checked against the exact all pairs result, so only up to the opening angle's accuracy
+    void validateKernel() {
+        if (!m_config.isNBody()) {
+            throw std::runtime_error("no CPU reference to validate the " + m_config.kernel + " kernel against!");
+        }
+
+        SimulationParams params = getStepParams();
+        m_stepParams->beginFrame(0);
+        uint32_t paramsOffset = m_stepParams->push(params);
+
+        // Frame 0 reads the last slot (or the sorted copy of it) and writes slot 0
+        uint32_t inSlot = m_grid ? getSortedSlot() : getSimulationSlotCount() - 1;
+        uint32_t outSlot = 0;
+
+        m_deviceCtx->executeCommand([&](VkCommandBuffer commandBuffer) {
+            if (m_grid) {
+                m_grid->recordBuild(commandBuffer, m_sortDescriptorSets[0][PreviousToCurrent]);
+            }
+            if (m_tree) {
+                m_tree->recordBuild(commandBuffer, m_computeDescriptorSets[0][PreviousToCurrent][0]);
+            }
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 1, 1, &m_stepParamsDescriptorSet, 1, &paramsOffset);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1, &m_computeDescriptorSets[0][PreviousToCurrent][0], 0, nullptr);
+            recordChunkFirst(commandBuffer, m_particleChunks[0].firstParticle);
+            vkCmdDispatch(commandBuffer, getGroupCount(m_particleChunks[0].particleCount), 1, 1);
+
+            recordComputeBarrier(commandBuffer, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        }, m_deviceCtx->m_computeQueueCtx);
+
+        std::vector<Particle> input = readbackParticles(inSlot);
+        std::vector<Particle> output = readbackParticles(outSlot);
+
+        // Evenly spread sample, the reference costs a full pass over the particles each
+        const size_t sampleCount = std::min<size_t>(1024, input.size());
+        std::vector<Particle> expected(sampleCount);
+        float maxSpeed = 0.0f;
+        for (size_t i = 0; i < sampleCount; i++) {
+            expected[i] = NBodyReference::step(params, input, i * input.size() / sampleCount);
+            maxSpeed = std::max(maxSpeed, glm::length(expected[i].velocity));
+        }
+
+        float maxVelocityError = 0.0f;
+        float maxPositionError = 0.0f;
+
+        // Relative error of the velocity change, leaving out the particles that bounced off a wall
+        double pullErrorSum = 0.0;
+        double pullSum = 0.0;
+
+        for (size_t i = 0; i < sampleCount; i++) {
+            size_t index = i * input.size() / sampleCount;
+            const Particle& actual = output[index];
+            maxVelocityError = std::max(maxVelocityError, glm::length(actual.velocity - expected[i].velocity));
+            maxPositionError = std::max(maxPositionError, glm::length(actual.position - expected[i].position));
+
+            bool bounced = std::abs(expected[i].position.x) == 1.0f || std::abs(expected[i].position.y) == 1.0f;
+            if (!bounced) {
+                glm::vec2 expectedPull = expected[i].velocity - input[index].velocity;
+                glm::vec2 pullError = actual.velocity - expected[i].velocity;
+                pullErrorSum += glm::dot(pullError, pullError);
+                pullSum += glm::dot(expectedPull, expectedPull);
+            }
+        }
+        float pullError = pullSum > 0.0 ? static_cast<float>(std::sqrt(pullErrorSum / pullSum)) : 0.0f;
+
+        // fp16 velocities only keep about 3 significant digits
+        bool compact = m_config.encoding == ParticleEncoding::Compact;
+        float velocityTolerance = (compact ? 2e-3f : 1e-4f) * std::max(maxSpeed, 1e-6f);
+        float positionTolerance = 1e-5f;
+        float pullTolerance = compact ? 0.2f : 0.05f;
+
+        std::cout << "Validated " << sampleCount << " particles: max velocity error " << maxVelocityError
+                  << ", max position error " << maxPositionError << ", relative pull error " << pullError << "\n";
+
+        bool matches;
+        if (m_config.kernel == "barneshut") {
+            std::cout << "Tolerance: relative pull error " << pullTolerance << " at opening angle " << m_physics.openingAngle << "\n";
+            matches = pullError <= pullTolerance;
+        } else {
+            std::cout << "Tolerance: velocity " << velocityTolerance << ", position " << positionTolerance << "\n";
+            matches = maxVelocityError <= velocityTolerance && maxPositionError <= positionTolerance;
+        }
+
+        if (!matches) {
+            throw std::runtime_error("the " + m_config.kernel + " kernel doesn't match its CPU reference!");
+        }
+    }
+
+    // Times RadixSort on its own, one submission per sort and the same random keys copied in before each.
+    // The run stats get the sorts as the compute pass, and the result of the last one is checked
+    void benchmarkSort() {
+        uint32_t count = m_config.particleCount;
+        RadixSort sort(*m_deviceCtx, count, m_config.workgroupSize, getScanPath(), "shaders/" + m_config.getShaderVariant());
+
+        std::vector<uint32_t> keys(count);
+        for (auto& key : keys) {
+            key = static_cast<uint32_t>(rngEngine());
+        }
+
+        VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(uint32_t);
+        GpuBuffer sourceKeys(
+            *m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx->m_computeQueueCtx
+        );
+        sourceKeys.copyFromCpu(keys.data(), size);
+        m_deviceCtx->m_stagingRing->waitIdle();
+
+        GpuProfiler profiler(*m_deviceCtx, 1);
+        double startTime = m_windowCtx->getTime();
+
+        for (uint32_t i = 0; i < m_config.warmupSteps + m_config.steps; i++) {
+            if (i == m_config.warmupSteps) {
+                profiler.clear();
+                startTime = m_windowCtx->getTime();
+            }
+
+            // executeCommand waits for the queue, so the last sort's queries are always ready
+            profiler.collect(GpuPass::Compute, 0);
+
+            m_deviceCtx->executeCommand([&](VkCommandBuffer commandBuffer) {
+                VkBufferCopy region{};
+                region.size = size;
+                vkCmdCopyBuffer(commandBuffer, sourceKeys.m_vkBuffer, sort.getKeys().m_vkBuffer, 1, &region);
+                recordComputeBarrier(commandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+                profiler.begin(commandBuffer, GpuPass::Compute, 0);
+                sort.recordSort(commandBuffer, count);
+                profiler.end(commandBuffer, GpuPass::Compute, 0);
+            }, m_deviceCtx->m_computeQueueCtx);
+
+            profiler.submitted(GpuPass::Compute, 0);
+        }
+        profiler.collect(GpuPass::Compute, 0);
+
+        m_runStats.steps = m_config.steps;
+        m_runStats.wallMs = (m_windowCtx->getTime() - startTime) * 1000.0;
+        m_runStats.compute = profiler.getStats(GpuPass::Compute);
+
+        // Every pass reads the keys twice and the values once, and writes both
+        uint32_t passCount = 32 / RadixSort::RADIX_BITS;
+        m_runStats.computeBytesPerStep = static_cast<uint64_t>(count) * sizeof(uint32_t) * 5 * passCount;
+
+        GpuBuffer readbackBuffer(
+            *m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_deviceCtx->m_computeQueueCtx
+        );
+        readbackBuffer.copyFromBuffer(sort.getKeys(), size);
+
+        std::vector<uint32_t> sorted(count);
+        readbackBuffer.mapAndRead(sorted.data(), size);
+
+        std::sort(keys.begin(), keys.end());
+        if (sorted != keys) {
+            throw std::runtime_error("radix sort result doesn't match std::sort!");
+        }
+
+        double sortMs = m_runStats.compute.samples > 0 ? m_runStats.compute.averageMs : m_runStats.wallMs / std::max<uint32_t>(m_config.steps, 1);
+        std::cout << "Radix sort: " << count << " keys in " << sortMs << " ms (" << count / (sortMs * 1000.0) << " Mkeys/s)\n";
+    }
+
+    void benchmarkScan() {
+        uint32_t count = m_config.particleCount;
+        PrefixScan scan(*m_deviceCtx, count, getScanPath(), "shaders/" + m_config.getShaderVariant());
+
+        // Small values like the compaction's flags, so the sums stay far from wrapping around
+        std::vector<uint32_t> values(count);
+        for (auto& value : values) {
+            value = static_cast<uint32_t>(rngEngine() % 4);
+        }
+
+        VkDeviceSize size = static_cast<VkDeviceSize>(count) * sizeof(uint32_t);
+        GpuBuffer sourceValues(
+            *m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx->m_computeQueueCtx
+        );
+        sourceValues.copyFromCpu(values.data(), size);
+        m_deviceCtx->m_stagingRing->waitIdle();
+
+        GpuProfiler profiler(*m_deviceCtx, 1);
+        double startTime = m_windowCtx->getTime();
+
+        for (uint32_t i = 0; i < m_config.warmupSteps + m_config.steps; i++) {
+            if (i == m_config.warmupSteps) {
+                profiler.clear();
+                startTime = m_windowCtx->getTime();
+            }
+
+            // executeCommand waits for the queue, so the last scan's queries are always ready
+            profiler.collect(GpuPass::Compute, 0);
+
+            m_deviceCtx->executeCommand([&](VkCommandBuffer commandBuffer) {
+                VkBufferCopy region{};
+                region.size = size;
+                vkCmdCopyBuffer(commandBuffer, sourceValues.m_vkBuffer, scan.getValues().m_vkBuffer, 1, &region);
+                recordComputeBarrier(commandBuffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+                profiler.begin(commandBuffer, GpuPass::Compute, 0);
+                scan.recordScan(commandBuffer, count);
+                profiler.end(commandBuffer, GpuPass::Compute, 0);
+            }, m_deviceCtx->m_computeQueueCtx);
+
+            profiler.submitted(GpuPass::Compute, 0);
+        }
+        profiler.collect(GpuPass::Compute, 0);
+
+        m_runStats.steps = m_config.steps;
+        m_runStats.wallMs = (m_windowCtx->getTime() - startTime) * 1000.0;
+        m_runStats.compute = profiler.getStats(GpuPass::Compute);
+
+        // The first pass reads and writes every value, the last one reads and writes them again
+        m_runStats.computeBytesPerStep = static_cast<uint64_t>(count) * sizeof(uint32_t) * 4;
+
+        GpuBuffer readbackBuffer(
+            *m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            m_deviceCtx->m_computeQueueCtx
+        );
+        readbackBuffer.copyFromBuffer(scan.getValues(), size);
+
+        std::vector<uint32_t> offsets(count);
+        readbackBuffer.mapAndRead(offsets.data(), size);
+
+        std::exclusive_scan(values.begin(), values.end(), values.begin(), 0u);
+        if (offsets != values) {
+            throw std::runtime_error("prefix scan result doesn't match std::exclusive_scan!");
+        }
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        double scanMs = m_runStats.compute.samples > 0 ? m_runStats.compute.averageMs : m_runStats.wallMs / std::max<uint32_t>(m_config.steps, 1);
+        std::cout << "Prefix scan: " << count << " values in " << scanMs << " ms (" << count / (scanMs * 1000.0) << " Mvalues/s)\n";
     }
 
-    void updateUniformBuffers(uint32_t index) {
-        UniformBufferObject ubo{};
-        ubo.deltaTime = 0.2f;
+    // Copies a slot's simulated streams back to the host, spawn only streams keep their defaults
+    std::vector<Particle> readbackParticles(uint32_t slot) {
+        std::vector<Particle> particles(m_particleChunks[0].particleCount);
+
+        for (size_t stream = 0; stream < m_particleStreams.size(); stream++) {
+            if (!m_particleStreams[stream].simulated) {
+                continue;
+            }
+
+            GpuBuffer& src = *m_shaderStorageBuffers[slot][0][stream];
+            VkDeviceSize size = static_cast<VkDeviceSize>(m_particleStreams[stream].stride) * particles.size();
 
-        rngUbo rngUbo{};
-        rngUbo.value = getRandomFloat();
+            GpuBuffer readbackBuffer(
+                *m_deviceCtx,
+                size,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                m_deviceCtx->m_computeQueueCtx
+            );
+            readbackBuffer.copyFromBuffer(src, size);
 
-        m_uniformBuffers[index]->mapAndWrite(&ubo, sizeof(ubo));
-        m_rngUbo[index]->mapAndWrite(&rngUbo, sizeof(rngUbo));
+            std::vector<char> data(size);
+            readbackBuffer.mapAndRead(data.data(), size);
+            Particle::decodeStream(m_config.layout, m_config.encoding, stream, data.data(), particles);
+        }
+
+        return particles;
     }
 
     void mainLoop() {
+        double startTime = m_windowCtx->getTime();
+        lastTime = startTime;
+
+        uint32_t frame = 0;
+        uint32_t measuredStepStart = 0;
         while (!m_windowCtx->shouldClose()) {
             m_windowCtx->update();
-            drawFrame();
+
+            // Headless warmup is over, only time from here on
+            if (m_config.headless && frame++ == m_config.warmupSteps) {
+                startTime = m_windowCtx->getTime();
+                measuredStepStart = m_stepIndex;
+                if (m_profiler) {
+                    m_profiler->clear();
+                }
+            }
+
+            if (m_config.headless) {
+                drawOffscreenFrame();
+            } else {
+                drawFrame();
+            }
+            m_scheduler->endFrame();
 
             double currentTime = m_windowCtx->getTime();
             lastFrameTime = (currentTime - lastTime) * 1000.0;
             lastTime = currentTime;
+
+            if (m_profiler) {
+                m_profiler->addFrameTime(lastFrameTime);
+            }
         }
 
         vkDeviceWaitIdle(m_deviceCtx->m_logicalDevice);
+
+        if (m_profiler) {
+            // Whatever is still in flight finished with the wait above
+            for (uint32_t i = 0; i < m_config.framesInFlight; i++) {
+                m_profiler->collect(GpuPass::Compute, i);
+                m_profiler->collect(GpuPass::Graphics, i);
+            }
+            m_profiler->printSummary();
+            m_deviceCtx->m_memoryAllocator->printStats();
+        }
+
+        if (m_lifecycle) {
+            std::cout << "Alive particles: " << m_lifecycle->readAliveCount(m_simulationSlot) << " of " << m_config.particleCount << "\n";
+        }
+
+        if (m_reorder) {
+            for (uint32_t i = 0; i < m_config.framesInFlight; i++) {
+                m_reorder->collect(i);
+            }
+
+            MortonReorderStats reorder = m_reorder->getStats();
+            std::cout << "Morton re-sort: " << reorder.sorts << " sorts, neighbors in memory sharing a cell "
+                      << reorder.sameCellBefore * 100.0 << "% before, " << reorder.sameCellAfter * 100.0 << "% after\n";
+            m_runStats.reorder = reorder;
+        }
+
+        if (m_hasher) {
+            for (uint32_t i = 0; i < m_config.framesInFlight; i++) {
+                m_hasher->collect(i);
+            }
+            std::cout << "State hashes: " << m_hasher->getHashCount() << (m_config.hashLog.empty() ? "" : " written to " + m_config.hashLog) << "\n";
+        }
+
+        if (m_config.headless) {
+            m_runStats.steps = m_config.steps;
+            m_runStats.wallMs = (m_windowCtx->getTime() - startTime) * 1000.0;
+
+            double substepsPerStep = static_cast<double>(m_stepIndex - measuredStepStart) / std::max<uint32_t>(m_config.steps, 1);
+            for (const auto& stream : m_particleStreams) {
+                if (stream.simulated) {
+                    m_runStats.computeBytesPerStep += static_cast<uint64_t>(2.0 * stream.stride * m_config.particleCount * substepsPerStep);
+                }
+            }
+
+            if (m_profiler) {
+                m_runStats.compute = m_profiler->getStats(GpuPass::Compute);
+                m_runStats.graphics = m_profiler->getStats(GpuPass::Graphics);
+                m_runStats.frame = m_profiler->getFrameTimeStats();
+            }
+
+            std::cout << "Headless run: " << m_config.steps << " steps in " << m_runStats.wallMs << " ms ("
+                      << m_runStats.wallMs / std::max<uint32_t>(m_config.steps, 1) << " ms/step)\n";
+
+            if (!m_config.output.empty()) {
+                saveOffscreenImage(m_config.output);
+            }
+        }
     }
 };
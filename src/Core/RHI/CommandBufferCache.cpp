@@ -0,0 +1,44 @@
+#include "CommandBufferCache.hpp"
+
+#include <stdexcept>
+
+CommandBufferCache::CommandBufferCache(DeviceContext& deviceCtx, const QueueContext& queueCtx) : m_deviceCtx(deviceCtx), m_queueCtx(queueCtx) {
+}
+
+CommandBufferCache::~CommandBufferCache() {
+    clear();
+}
+
+VkCommandBuffer CommandBufferCache::get(uint64_t key, const std::function<void(VkCommandBuffer)>& recorder) {
+    auto found = m_commandBuffers.find(key);
+    if (found != m_commandBuffers.end()) {
+        return found->second;
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = m_queueCtx.mainCmdPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(m_deviceCtx.m_logicalDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cached command buffer!");
+    }
+
+    recorder(commandBuffer);
+
+    m_commandBuffers.emplace(key, commandBuffer);
+    return commandBuffer;
+}
+
+void CommandBufferCache::clear() {
+    for (auto& [key, commandBuffer] : m_commandBuffers) {
+        vkFreeCommandBuffers(m_deviceCtx.m_logicalDevice, m_queueCtx.mainCmdPool, 1, &commandBuffer);
+    }
+    m_commandBuffers.clear();
+}
+
+size_t CommandBufferCache::size() const {
+    return m_commandBuffers.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+
+// Command buffers recorded once and replayed, looked up by a caller chosen key that has to
+// capture everything the recording depends on. Anything that changes every frame has to be
+// read by the GPU from memory (persistently mapped buffers) instead of being baked in.
+// A cached command buffer is never re-recorded, so the caller must not resubmit one that is still
+// pending, keys including the frame slot get that for free from the frame slot wait.
+class CommandBufferCache {
+public:
+    CommandBufferCache(DeviceContext& deviceCtx, const QueueContext& queueCtx);
+    ~CommandBufferCache();
+
+    CommandBufferCache(const CommandBufferCache&) = delete;
+    CommandBufferCache& operator=(const CommandBufferCache&) = delete;
+
+    // The cached command buffer, recorded by the recorder on the first request for the key.
+    // The recorder does the begin/end itself
+    VkCommandBuffer get(uint64_t key, const std::function<void(VkCommandBuffer)>& recorder);
+
+    // Drops every command buffer, none of them may be pending anymore
+    void clear();
+
+    size_t size() const;
+
+private:
+    DeviceContext& m_deviceCtx;
+    const QueueContext& m_queueCtx;
+
+    std::unordered_map<uint64_t, VkCommandBuffer> m_commandBuffers;
+};
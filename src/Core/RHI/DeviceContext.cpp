@@ -1,5 +1,6 @@
 #include "DeviceContext.hpp"
 
+#include <algorithm>
 #include <cstdint>
 #include <set>
 #include <map>
@@ -8,6 +9,8 @@
 #include <stdexcept>
 #include <vector>
 
+#include "Core/RHI/DeviceMemoryAllocator.hpp"
+#include "Core/RHI/StagingRing.hpp"
 #include "Core/RHI/Types/AppTypes.hpp"
 #include "Core/RHI/Types/QueueCriteria.hpp"
 
@@ -28,9 +31,16 @@ DeviceContext::DeviceContext(VkInstance instance, VkSurfaceKHR surface, const st
     createLogicalDevice(surface, enableValidationLayers, validationLayers);
     createCommandPools();
     createTextureSampler();
+
+    m_memoryAllocator = std::make_unique<DeviceMemoryAllocator>(*this);
+    m_stagingRing = std::make_unique<StagingRing>(*this, STAGING_RING_SIZE);
 }
 
 DeviceContext::~DeviceContext() {
+    // Waits for pending uploads, needs the command pools alive
+    m_stagingRing.reset();
+    m_memoryAllocator.reset();
+
     vkDestroyCommandPool(m_logicalDevice, m_graphicsQueueCtx.mainCmdPool, nullptr);
     vkDestroyCommandPool(m_logicalDevice, m_transferQueueCtx.mainCmdPool, nullptr);
     vkDestroyCommandPool(m_logicalDevice, m_computeQueueCtx.mainCmdPool, nullptr);
@@ -104,8 +114,9 @@ bool DeviceContext::isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR surfa
 
     bool areExtensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool isSwapChainAdequate = false;
-    if (areExtensionsSupported) {
+    // Headless runs have no surface to present to, so any swap chain is adequate
+    bool isSwapChainAdequate = surface == VK_NULL_HANDLE;
+    if (areExtensionsSupported && surface != VK_NULL_HANDLE) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
         isSwapChainAdequate = !swapChainSupport.formats.empty() &&!swapChainSupport.presentModes.empty();
     }
@@ -188,7 +199,7 @@ bool DeviceContext::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surf
     
     QueueCriteria presentCriteria =
         QueueCriteria::startCriteria(baseCriteria, &m_presentQueueCtx)
-            .requireSurfaceSupport(m_physicalDevice, surface);
+            .requireSurfaceSupport(device, surface);
     
     QueueCriteria graphicsCriteria =
         QueueCriteria::startCriteria(baseCriteria, &m_graphicsQueueCtx)
@@ -209,12 +220,16 @@ bool DeviceContext::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surf
             ;
 
     std::vector<QueueCriteria*> criterias = {
-        &presentCriteria,
         &graphicsCriteria,
         &transferCriteria,
         &computeCriteria
     };
 
+    // Without a surface nothing gets presented, the present queue just aliases the graphics one
+    if (surface != VK_NULL_HANDLE) {
+        criterias.insert(criterias.begin(), &presentCriteria);
+    }
+
     for(QueueCriteria* criteria : criterias) {
         int32_t bestIndex = criteria->evaluateQueues(queueFamilies);
 
@@ -226,6 +241,10 @@ bool DeviceContext::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surf
             criteria->m_queueCtxToFit->queueFamilyIndex = static_cast<uint32_t>(bestIndex);
         }
     }
+
+    if (keepChoices && surface == VK_NULL_HANDLE) {
+        m_presentQueueCtx.queueFamilyIndex = m_graphicsQueueCtx.queueFamilyIndex;
+    }
     
     return true;
 }
@@ -253,10 +272,22 @@ void DeviceContext::createLogicalDevice(VkSurfaceKHR surface, bool enableValidat
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.sampleRateShading = VK_TRUE;
+
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+
+    m_pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery;
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
     
     VkPhysicalDeviceSynchronization2Features sync2Features = {};
     sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
     sync2Features.synchronization2 = VK_TRUE;
+
+    // Frame pacing runs on timeline semaphores
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+    vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+    sync2Features.pNext = &vulkan12Features;
     
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -352,6 +383,9 @@ void DeviceContext::executeCommand(const std::function<void(VkCommandBuffer)> &r
 }
 
 void DeviceContext::executeCommand(const std::function<void(VkCommandBuffer)> &recorder, VkQueue queue, VkCommandPool cmdPool) {
+    // Uploads queued before this command have to land first
+    m_stagingRing->waitIdle();
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -397,6 +431,22 @@ uint32_t DeviceContext::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
     throw std::runtime_error("failed to find a suitable memory type!");
 }
 
+// Largest range a single storage buffer can be bound (and allocated) with
+VkDeviceSize DeviceContext::getMaxStorageBufferRange() {
+    VkPhysicalDeviceMaintenance3Properties maintenance3Properties{};
+    maintenance3Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_3_PROPERTIES;
+
+    VkPhysicalDeviceProperties2 properties{};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &maintenance3Properties;
+    vkGetPhysicalDeviceProperties2(m_physicalDevice, &properties);
+
+    return std::min<VkDeviceSize>(
+        properties.properties.limits.maxStorageBufferRange,
+        maintenance3Properties.maxMemoryAllocationSize
+    );
+}
+
 VkSampleCountFlagBits DeviceContext::getMaxUsableSampleCount() {
     VkPhysicalDeviceProperties physicalDeviceProperties;
     vkGetPhysicalDeviceProperties(m_physicalDevice, &physicalDeviceProperties);
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -7,6 +8,8 @@
 #include "Core/RHI/Types/AppTypes.hpp"
 
 struct VulkanContext; 
+class StagingRing;
+class DeviceMemoryAllocator;
 
 class DeviceContext {
 public:
@@ -28,10 +31,21 @@ public:
     QueueContext m_computeQueueCtx;
 
     std::vector<const char*> m_requiredDeviceExtensions;
+
+    // Optional features, enabled when the device has them
+    bool m_pipelineStatisticsEnabled = false;
+
+    // Every buffer/image memory comes from here, see DeviceMemoryAllocator
+    std::unique_ptr<DeviceMemoryAllocator> m_memoryAllocator;
+
+    // Shared upload space for every CPU -> GPU copy, see StagingRing
+    static constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+    std::unique_ptr<StagingRing> m_stagingRing;
     
     SwapChainSupportDetails querySwapChainSupport(VkSurfaceKHR surface);
     VkSampleCountFlagBits getMaxUsableSampleCount();
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    VkDeviceSize getMaxStorageBufferRange();
 
     void executeCommand(const std::function<void(VkCommandBuffer)> &recorder, const QueueContext &queueCtx);
     void executeCommand(const std::function<void(VkCommandBuffer)> &recorder, const QueueContext &queueCtx, VkCommandPool cmdPool);
@@ -0,0 +1,305 @@
+#include "DeviceMemoryAllocator.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+#include "Core/RHI/DeviceContext.hpp"
+
+struct MemoryBlock {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    char* mapped = nullptr;
+
+    uint32_t memoryType = 0;
+    bool linear = true;
+
+    // Free offsets per buddy order, order k holds MIN_ALLOCATION_SIZE << k bytes
+    std::vector<std::vector<VkDeviceSize>> freeLists;
+    uint32_t allocationCount = 0;
+};
+
+namespace {
+    VkDeviceSize floorPowerOfTwo(VkDeviceSize value) {
+        VkDeviceSize result = 1;
+        while (result * 2 <= value) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    uint32_t orderForSize(VkDeviceSize size) {
+        uint32_t order = 0;
+        while ((DeviceMemoryAllocator::MIN_ALLOCATION_SIZE << order) < size) {
+            order++;
+        }
+        return order;
+    }
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(DeviceContext& deviceCtx, VkDeviceSize blockSize) : m_deviceCtx(deviceCtx), m_blockSize(blockSize) {
+    vkGetPhysicalDeviceMemoryProperties(m_deviceCtx.m_physicalDevice, &m_memProperties);
+
+    m_pools.resize(m_memProperties.memoryTypeCount);
+    m_stats.resize(m_memProperties.memoryTypeCount);
+
+    // Small heaps (e.g. the host visible part of VRAM) get smaller blocks so a single block can't eat them
+    for (uint32_t i = 0; i < m_memProperties.memoryTypeCount; i++) {
+        VkDeviceSize heapSize = m_memProperties.memoryHeaps[m_memProperties.memoryTypes[i].heapIndex].size;
+        VkDeviceSize poolBlockSize = floorPowerOfTwo(std::max(std::min(m_blockSize, heapSize / 8), MIN_ALLOCATION_SIZE));
+
+        for (auto& pool : m_pools[i]) {
+            pool.blockSize = poolBlockSize;
+        }
+    }
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator() {
+    for (auto& pools : m_pools) {
+        for (auto& pool : pools) {
+            for (auto& block : pool.blocks) {
+                if (block->allocationCount > 0) {
+                    std::cerr << "Device memory block freed with " << block->allocationCount << " live allocations!" << std::endl;
+                }
+                destroyBlock(*block);
+            }
+        }
+    }
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear) {
+    MemoryAllocation allocation{};
+    allocation.memoryType = m_deviceCtx.findMemoryType(requirements.memoryTypeBits, properties);
+
+    Pool& pool = m_pools[allocation.memoryType][linear ? 1 : 0];
+    DeviceMemoryStats& stats = m_stats[allocation.memoryType];
+
+    // Buddy offsets are multiples of their size, so rounding up to the alignment is enough
+    VkDeviceSize roundedSize = std::max({ requirements.size, requirements.alignment, MIN_ALLOCATION_SIZE });
+
+    if (roundedSize > pool.blockSize / 2) {
+        allocation.memory = allocateDeviceMemory(requirements.size, allocation.memoryType, &allocation.mapped);
+        allocation.size = requirements.size;
+
+        stats.dedicatedCount++;
+        stats.dedicatedBytes += allocation.size;
+        return allocation;
+    }
+
+    allocation.order = orderForSize(roundedSize);
+
+    // First block with a free range at or above the wanted order
+    MemoryBlock* block = nullptr;
+    uint32_t foundOrder = 0;
+    for (auto& candidate : pool.blocks) {
+        for (uint32_t order = allocation.order; order < candidate->freeLists.size(); order++) {
+            if (!candidate->freeLists[order].empty()) {
+                block = candidate.get();
+                foundOrder = order;
+                break;
+            }
+        }
+        if (block) {
+            break;
+        }
+    }
+
+    if (!block) {
+        block = createBlock(pool, allocation.memoryType);
+        block->linear = linear;
+        foundOrder = static_cast<uint32_t>(block->freeLists.size() - 1);
+    }
+
+    VkDeviceSize offset = block->freeLists[foundOrder].back();
+    block->freeLists[foundOrder].pop_back();
+
+    // Split down to the wanted order, the upper halves go back as free buddies
+    while (foundOrder > allocation.order) {
+        foundOrder--;
+        block->freeLists[foundOrder].push_back(offset + (MIN_ALLOCATION_SIZE << foundOrder));
+    }
+
+    block->allocationCount++;
+
+    allocation.memory = block->memory;
+    allocation.offset = offset;
+    allocation.size = MIN_ALLOCATION_SIZE << allocation.order;
+    allocation.mapped = block->mapped ? block->mapped + offset : nullptr;
+    allocation.block = block;
+
+    stats.allocationCount++;
+    stats.usedBytes += allocation.size;
+    return allocation;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation) {
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    DeviceMemoryStats& stats = m_stats[allocation.memoryType];
+
+    if (!allocation.block) {
+        vkFreeMemory(m_deviceCtx.m_logicalDevice, allocation.memory, nullptr);
+
+        stats.dedicatedCount--;
+        stats.dedicatedBytes -= allocation.size;
+        allocation = MemoryAllocation{};
+        return;
+    }
+
+    MemoryBlock* block = allocation.block;
+    VkDeviceSize offset = allocation.offset;
+    uint32_t order = allocation.order;
+
+    // Merge with the buddy for as long as it is free too
+    while (order + 1 < block->freeLists.size()) {
+        VkDeviceSize buddy = offset ^ (MIN_ALLOCATION_SIZE << order);
+        auto& freeList = block->freeLists[order];
+
+        auto it = std::find(freeList.begin(), freeList.end(), buddy);
+        if (it == freeList.end()) {
+            break;
+        }
+
+        freeList.erase(it);
+        offset = std::min(offset, buddy);
+        order++;
+    }
+    block->freeLists[order].push_back(offset);
+    block->allocationCount--;
+
+    stats.allocationCount--;
+    stats.usedBytes -= allocation.size;
+
+    // Keep one empty block around per pool, so a free/allocate pair doesn't hit the driver
+    Pool& pool = m_pools[block->memoryType][block->linear ? 1 : 0];
+    if (block->allocationCount == 0 && pool.blocks.size() > 1) {
+        destroyBlock(*block);
+
+        stats.blockCount--;
+        stats.blockBytes -= block->size;
+
+        std::erase_if(pool.blocks, [&](const std::unique_ptr<MemoryBlock>& candidate) { return candidate.get() == block; });
+    }
+
+    allocation = MemoryAllocation{};
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties) {
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(m_deviceCtx.m_logicalDevice, buffer, &memRequirements);
+
+    MemoryAllocation allocation = allocate(memRequirements, properties, true);
+
+    if (vkBindBufferMemory(m_deviceCtx.m_logicalDevice, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        free(allocation);
+        throw std::runtime_error("failed to bind buffer memory!");
+    }
+
+    return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocateForImage(VkImage image, VkMemoryPropertyFlags properties) {
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(m_deviceCtx.m_logicalDevice, image, &memRequirements);
+
+    MemoryAllocation allocation = allocate(memRequirements, properties, false);
+
+    if (vkBindImageMemory(m_deviceCtx.m_logicalDevice, image, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        free(allocation);
+        throw std::runtime_error("failed to bind image memory!");
+    }
+
+    return allocation;
+}
+
+bool DeviceMemoryAllocator::isHostCoherent(uint32_t memoryType) const {
+    return m_memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+std::vector<DeviceMemoryStats> DeviceMemoryAllocator::getStats() const {
+    return m_stats;
+}
+
+DeviceMemoryStats DeviceMemoryAllocator::getTotalStats() const {
+    DeviceMemoryStats total{};
+    for (const auto& stats : m_stats) {
+        total.blockCount += stats.blockCount;
+        total.blockBytes += stats.blockBytes;
+        total.dedicatedCount += stats.dedicatedCount;
+        total.dedicatedBytes += stats.dedicatedBytes;
+        total.allocationCount += stats.allocationCount;
+        total.usedBytes += stats.usedBytes;
+    }
+    return total;
+}
+
+void DeviceMemoryAllocator::printStats() const {
+    auto toMiB = [](VkDeviceSize bytes) { return static_cast<double>(bytes) / (1024.0 * 1024.0); };
+
+    std::cout << "Device memory -v-\n";
+    for (uint32_t i = 0; i < m_stats.size(); i++) {
+        const DeviceMemoryStats& stats = m_stats[i];
+        if (stats.blockCount == 0 && stats.dedicatedCount == 0) {
+            continue;
+        }
+
+        std::cout << "Type " << i << ": "
+            << stats.allocationCount << " allocations using " << toMiB(stats.usedBytes) << " of "
+            << toMiB(stats.blockBytes) << " MiB in " << stats.blockCount << " blocks, "
+            << stats.dedicatedCount << " dedicated (" << toMiB(stats.dedicatedBytes) << " MiB)\n";
+    }
+
+    DeviceMemoryStats total = getTotalStats();
+    std::cout << "vkAllocateMemory objects: " << total.blockCount + total.dedicatedCount
+        << " for " << total.allocationCount + total.dedicatedCount << " resources\n";
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory;
+    if (vkAllocateMemory(m_deviceCtx.m_logicalDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory!");
+    }
+
+    *mapped = nullptr;
+    if (m_memProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        if (vkMapMemory(m_deviceCtx.m_logicalDevice, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+            vkFreeMemory(m_deviceCtx.m_logicalDevice, memory, nullptr);
+            throw std::runtime_error("failed to map device memory!");
+        }
+    }
+
+    return memory;
+}
+
+MemoryBlock* DeviceMemoryAllocator::createBlock(Pool& pool, uint32_t memoryType) {
+    auto block = std::make_unique<MemoryBlock>();
+    block->size = pool.blockSize;
+    block->memoryType = memoryType;
+
+    void* mapped = nullptr;
+    block->memory = allocateDeviceMemory(block->size, memoryType, &mapped);
+    block->mapped = static_cast<char*>(mapped);
+
+    // The whole block starts as one free range of the top order
+    block->freeLists.resize(orderForSize(block->size) + 1);
+    block->freeLists.back().push_back(0);
+
+    m_stats[memoryType].blockCount++;
+    m_stats[memoryType].blockBytes += block->size;
+
+    pool.blocks.push_back(std::move(block));
+    return pool.blocks.back().get();
+}
+
+void DeviceMemoryAllocator::destroyBlock(MemoryBlock& block) {
+    // Freeing implicitly unmaps
+    vkFreeMemory(m_deviceCtx.m_logicalDevice, block.memory, nullptr);
+    block.memory = VK_NULL_HANDLE;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+class DeviceContext;
+struct MemoryBlock;
+
+// A piece of device memory, either a range inside a shared block or a dedicated allocation
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+
+    // Persistently mapped pointer to offset, null unless the memory is host visible
+    void* mapped = nullptr;
+
+    uint32_t memoryType = 0;
+
+    // Owning block and buddy order, null block means dedicated
+    MemoryBlock* block = nullptr;
+    uint32_t order = 0;
+};
+
+struct DeviceMemoryStats {
+    uint32_t blockCount = 0;
+    VkDeviceSize blockBytes = 0;
+
+    uint32_t dedicatedCount = 0;
+    VkDeviceSize dedicatedBytes = 0;
+
+    // Sub-allocations handed out from the blocks, with their rounded up sizes
+    uint32_t allocationCount = 0;
+    VkDeviceSize usedBytes = 0;
+};
+
+// Sub-allocates buffers and images out of big VkDeviceMemory blocks, so only a handful of
+// vkAllocateMemory calls are made no matter how many resources exist.
+// Every memory type gets its own pools of blocks split with a buddy allocator: sizes are rounded
+// up to a power of two, which also covers any alignment up to that size. Linear (buffers) and
+// optimal (images) resources use separate pools so bufferImageGranularity never matters.
+// Anything bigger than half a block, like the particle SSBOs, gets a dedicated allocation.
+// Host visible memory is mapped once per block and stays mapped.
+class DeviceMemoryAllocator {
+public:
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+    static constexpr VkDeviceSize MIN_ALLOCATION_SIZE = 256;
+
+    DeviceMemoryAllocator(DeviceContext& deviceCtx, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    ~DeviceMemoryAllocator();
+
+    DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+    DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear);
+    void free(MemoryAllocation& allocation);
+
+    // Allocate and bind in one go
+    MemoryAllocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties);
+    MemoryAllocation allocateForImage(VkImage image, VkMemoryPropertyFlags properties);
+
+    bool isHostCoherent(uint32_t memoryType) const;
+
+    // Per memory type, index is the memory type
+    std::vector<DeviceMemoryStats> getStats() const;
+    DeviceMemoryStats getTotalStats() const;
+    void printStats() const;
+
+private:
+    struct Pool {
+        VkDeviceSize blockSize = 0;
+        std::vector<std::unique_ptr<MemoryBlock>> blocks;
+    };
+
+    DeviceContext& m_deviceCtx;
+    VkDeviceSize m_blockSize;
+
+    VkPhysicalDeviceMemoryProperties m_memProperties;
+
+    // [memory type][linear]
+    std::vector<std::array<Pool, 2>> m_pools;
+
+    std::vector<DeviceMemoryStats> m_stats;
+
+    VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, void** mapped);
+    MemoryBlock* createBlock(Pool& pool, uint32_t memoryType);
+    void destroyBlock(MemoryBlock& block);
+};
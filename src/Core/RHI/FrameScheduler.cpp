@@ -0,0 +1,115 @@
+#include "FrameScheduler.hpp"
+
+#include <stdexcept>
+#include <string>
+
+FrameScheduler::FrameScheduler(DeviceContext& deviceCtx, uint32_t framesInFlight) : m_deviceCtx(deviceCtx), m_framesInFlight(framesInFlight) {
+    if (framesInFlight == 0 || framesInFlight > MAX_FRAMES_IN_FLIGHT) {
+        throw std::runtime_error("frames in flight must be between 1 and " + std::to_string(MAX_FRAMES_IN_FLIGHT) + "!");
+    }
+
+    VkSemaphoreTypeCreateInfo typeInfo{};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo{};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(m_deviceCtx.m_logicalDevice, &semaphoreInfo, nullptr, &m_computeTimeline) != VK_SUCCESS ||
+        vkCreateSemaphore(m_deviceCtx.m_logicalDevice, &semaphoreInfo, nullptr, &m_graphicsTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphores!");
+    }
+}
+
+FrameScheduler::~FrameScheduler() {
+    vkDestroySemaphore(m_deviceCtx.m_logicalDevice, m_computeTimeline, nullptr);
+    vkDestroySemaphore(m_deviceCtx.m_logicalDevice, m_graphicsTimeline, nullptr);
+}
+
+uint32_t FrameScheduler::getFramesInFlight() const {
+    return m_framesInFlight;
+}
+
+uint64_t FrameScheduler::getFrameNumber() const {
+    return m_frameNumber;
+}
+
+uint32_t FrameScheduler::getFrameSlot() const {
+    return static_cast<uint32_t>(m_frameNumber % m_framesInFlight);
+}
+
+uint64_t FrameScheduler::getFrameValue(uint64_t frameNumber) const {
+    return frameNumber + 1;
+}
+
+VkSemaphore FrameScheduler::getTimeline(FrameQueue queue) const {
+    return queue == FrameQueue::Compute ? m_computeTimeline : m_graphicsTimeline;
+}
+
+void FrameScheduler::waitForSlot(FrameQueue queue) {
+    if (m_frameNumber >= m_framesInFlight) {
+        waitForFrame(queue, m_frameNumber - m_framesInFlight);
+    }
+}
+
+void FrameScheduler::waitForFrame(FrameQueue queue, uint64_t frameNumber) {
+    VkSemaphore timeline = getTimeline(queue);
+    uint64_t value = getFrameValue(frameNumber);
+
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
+
+    if (vkWaitSemaphores(m_deviceCtx.m_logicalDevice, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+}
+
+void FrameScheduler::submit(FrameQueue queue, VkCommandBuffer commandBuffer, const std::vector<SubmitWait>& waits, const std::vector<VkSemaphore>& binarySignals) {
+    std::vector<VkSemaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<VkPipelineStageFlags> waitStages;
+    for (const auto& wait : waits) {
+        waitSemaphores.push_back(wait.semaphore);
+        waitValues.push_back(wait.value);
+        waitStages.push_back(wait.stage);
+    }
+
+    std::vector<VkSemaphore> signalSemaphores = { getTimeline(queue) };
+    std::vector<uint64_t> signalValues = { getFrameValue(m_frameNumber) };
+    for (VkSemaphore semaphore : binarySignals) {
+        signalSemaphores.push_back(semaphore);
+        signalValues.push_back(0);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+    submitInfo.pWaitSemaphores = waitSemaphores.data();
+    submitInfo.pWaitDstStageMask = waitStages.data();
+    submitInfo.commandBufferCount = commandBuffer != VK_NULL_HANDLE ? 1 : 0;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    submitInfo.pSignalSemaphores = signalSemaphores.data();
+
+    VkQueue vkQueue = queue == FrameQueue::Compute ? m_deviceCtx.m_computeQueueCtx.queue : m_deviceCtx.m_graphicsQueueCtx.queue;
+    if (vkQueueSubmit(vkQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error(queue == FrameQueue::Compute ? "failed to submit compute command buffer!" : "failed to submit draw command buffer!");
+    }
+}
+
+void FrameScheduler::endFrame() {
+    m_frameNumber++;
+}
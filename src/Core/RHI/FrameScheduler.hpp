@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+
+enum class FrameQueue {
+    Compute,
+    Graphics,
+};
+
+// A semaphore wait for a submission, the value is ignored for binary semaphores
+struct SubmitWait {
+    VkSemaphore semaphore;
+    uint64_t value;
+    VkPipelineStageFlags stage;
+};
+
+// Paces frames with one timeline semaphore per queue instead of per-frame fences and semaphores.
+// Frame N's compute work signals the compute timeline to N + 1 and its graphics work signals the
+// graphics timeline to N + 1, so "is frame N done on that queue" is a counter comparison and the
+// cross-queue dependencies are plain GPU waits on counter values.
+// The CPU only blocks before reusing a frame slot's command buffers, framesInFlight frames back.
+class FrameScheduler {
+public:
+    static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+    FrameScheduler(DeviceContext& deviceCtx, uint32_t framesInFlight);
+    ~FrameScheduler();
+
+    FrameScheduler(const FrameScheduler&) = delete;
+    FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+    uint32_t getFramesInFlight() const;
+
+    // Frame being built, counting from 0
+    uint64_t getFrameNumber() const;
+
+    // Index of the per-frame resources (command buffers, query pools...) the current frame uses
+    uint32_t getFrameSlot() const;
+
+    // Timeline value the queue reaches once the given frame is done on it
+    uint64_t getFrameValue(uint64_t frameNumber) const;
+
+    VkSemaphore getTimeline(FrameQueue queue) const;
+
+    // Blocks until the queue finished the frame that last used the current slot
+    void waitForSlot(FrameQueue queue);
+
+    // Blocks until the queue finished the given frame
+    void waitForFrame(FrameQueue queue, uint64_t frameNumber);
+
+    // Submits the current frame's work for a queue, signaling its timeline (plus any binary semaphores).
+    // No command buffer still signals, for frames that had to skip their work
+    void submit(FrameQueue queue, VkCommandBuffer commandBuffer, const std::vector<SubmitWait>& waits, const std::vector<VkSemaphore>& binarySignals = {});
+
+    void endFrame();
+
+private:
+    DeviceContext& m_deviceCtx;
+    uint32_t m_framesInFlight;
+
+    uint64_t m_frameNumber = 0;
+
+    VkSemaphore m_computeTimeline = VK_NULL_HANDLE;
+    VkSemaphore m_graphicsTimeline = VK_NULL_HANDLE;
+};
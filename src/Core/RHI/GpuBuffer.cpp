@@ -1,41 +1,43 @@
 #include "GpuBuffer.hpp"
+#include <algorithm>
 #include <stdexcept>
 
+#include "Core/RHI/StagingRing.hpp"
+
 GpuBuffer::GpuBuffer(
     DeviceContext& deviceCtx,
     VkDeviceSize size,
     VkBufferUsageFlags usage,
     VkMemoryPropertyFlags properties,
-    QueueContext& queue
-) : m_deviceCtx(deviceCtx), m_size(size), m_queueCtx(queue) {
+    QueueContext& queue,
+    const std::vector<uint32_t>& sharedQueueFamilies
+) : m_size(size), m_queueCtx(queue), m_deviceCtx(deviceCtx) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateBuffer(m_deviceCtx.m_logicalDevice, &bufferInfo, nullptr, &m_vkBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create vertex buffer!");
-    }
+    std::vector<uint32_t> families = sharedQueueFamilies;
+    std::sort(families.begin(), families.end());
+    families.erase(std::unique(families.begin(), families.end()), families.end());
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(m_deviceCtx.m_logicalDevice, m_vkBuffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = m_deviceCtx.findMemoryType(memRequirements.memoryTypeBits, properties);
+    if (families.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+        bufferInfo.pQueueFamilyIndices = families.data();
+    }
 
-    if (vkAllocateMemory(m_deviceCtx.m_logicalDevice, &allocInfo, nullptr, &m_memory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    if (vkCreateBuffer(m_deviceCtx.m_logicalDevice, &bufferInfo, nullptr, &m_vkBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create vertex buffer!");
     }
 
-    vkBindBufferMemory(m_deviceCtx.m_logicalDevice, m_vkBuffer, m_memory, 0);
+    m_allocation = m_deviceCtx.m_memoryAllocator->allocateForBuffer(m_vkBuffer, properties);
 }
 
 GpuBuffer::~GpuBuffer() {
     vkDestroyBuffer(m_deviceCtx.m_logicalDevice, m_vkBuffer, nullptr);
-    vkFreeMemory(m_deviceCtx.m_logicalDevice, m_memory, nullptr);
+    m_deviceCtx.m_memoryAllocator->free(m_allocation);
 }
 
 void GpuBuffer::_rawCopyFromCpu(const void *sourceData, size_t size) {
@@ -46,25 +48,42 @@ void GpuBuffer::copyFromCpu(const void *sourceData) {
     copyFromCpu(sourceData, m_size);
 }
 
+// Asynchronous, the copy goes through the device staging ring and is only submitted on its next flush.
+// The source data may be freed right after this returns
 void GpuBuffer::copyFromCpu(const void *sourceData, size_t size) {
-    GpuBuffer stagingBuffer = GpuBuffer(
-        m_deviceCtx,
-        size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        m_queueCtx
-    );
+    if (m_allocation.mapped && m_deviceCtx.m_memoryAllocator->isHostCoherent(m_allocation.memoryType)) {
+        mapAndWrite(sourceData, size);
+        return;
+    }
 
-    stagingBuffer.mapAndWrite(sourceData, size);
-    this->copyFromBuffer(stagingBuffer);
-    vkQueueWaitIdle(m_queueCtx.queue);
+    m_deviceCtx.m_stagingRing->uploadToBuffer(m_vkBuffer, 0, sourceData, size, m_queueCtx);
 }
 
+// Host visible memory is mapped for its whole life by the allocator, these are plain memcpys
 void GpuBuffer::mapAndWrite(const void* data, VkDeviceSize size) {
-    void* mappedData;
-    vkMapMemory(m_deviceCtx.m_logicalDevice, m_memory, 0, size, 0, &mappedData);
-    memcpy(mappedData, data, (size_t)size);
-    vkUnmapMemory(m_deviceCtx.m_logicalDevice, m_memory);
+    writeMapped(data, size, 0);
+}
+
+void GpuBuffer::mapAndRead(void* data, VkDeviceSize size) {
+    if (!m_allocation.mapped) {
+        throw std::runtime_error("failed to read buffer, memory is not host visible!");
+    }
+    memcpy(data, m_allocation.mapped, (size_t)size);
+}
+
+bool GpuBuffer::isMapped() const {
+    return m_allocation.mapped != nullptr;
+}
+
+void* GpuBuffer::getMapped() const {
+    return m_allocation.mapped;
+}
+
+void GpuBuffer::writeMapped(const void* data, VkDeviceSize size, VkDeviceSize offset) {
+    if (!m_allocation.mapped) {
+        throw std::runtime_error("failed to write buffer, memory is not host visible!");
+    }
+    memcpy(static_cast<char*>(m_allocation.mapped) + offset, data, (size_t)size);
 }
 
 void GpuBuffer::copyFromBuffer(GpuBuffer &srcBuffer) {
@@ -120,4 +139,38 @@ void GpuBuffer::copyBufferToImage(Image &image) {
         },
         m_queueCtx
     );
+}
+
+// Expects the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+void GpuBuffer::copyFromImage(Image &image) {
+    VkBufferImageCopy region{};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    region.imageOffset = { 0, 0, 0 };
+    region.imageExtent = {
+        image.m_width,
+        image.m_height,
+        1
+    };
+
+    m_deviceCtx.executeCommand(
+        [&](VkCommandBuffer cmd) {
+            vkCmdCopyImageToBuffer(
+                cmd,
+                image.m_vkImage,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                m_vkBuffer,
+                1,
+                &region
+            );
+        },
+        m_queueCtx
+    );
 }
\ No newline at end of file
@@ -1,14 +1,18 @@
 #pragma once
 
+#include <vector>
+
 #include <vulkan/vulkan.h>
 
 #include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/DeviceMemoryAllocator.hpp"
 #include "Core/RHI/Types/AppTypes.hpp"
 #include "Core/Resources/Image.hpp"
 
 class GpuBuffer {
 public:
-    GpuBuffer(DeviceContext& deviceCtx, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, QueueContext& queueCtx);
+    // Passing more than one distinct queue family creates the buffer with concurrent sharing
+    GpuBuffer(DeviceContext& deviceCtx, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, QueueContext& queueCtx, const std::vector<uint32_t>& sharedQueueFamilies = {});
     ~GpuBuffer();
 
     GpuBuffer(const GpuBuffer&) = delete;
@@ -20,11 +24,18 @@ public:
     void copyFromCpu(const void *sourceData, size_t size);
 
     void mapAndWrite(const void* data, VkDeviceSize size);
+    void mapAndRead(void* data, VkDeviceSize size);
+
+    // Persistently mapped mode, host visible buffers stay mapped from creation to destruction
+    bool isMapped() const;
+    void* getMapped() const;
+    void writeMapped(const void* data, VkDeviceSize size, VkDeviceSize offset);
 
     void copyFromBuffer(GpuBuffer& srcBuffer);
     void copyFromBuffer(GpuBuffer& srcBuffer, VkDeviceSize size);
 
     void copyBufferToImage(Image &image);
+    void copyFromImage(Image &image);
 
     VkBuffer m_vkBuffer;
     
@@ -35,7 +46,7 @@ public:
 private:
     DeviceContext& m_deviceCtx;
     
-    VkDeviceMemory m_memory;
+    MemoryAllocation m_allocation;
 
     void* BufferPP;
 };
\ No newline at end of file
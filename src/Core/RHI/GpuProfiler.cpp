@@ -0,0 +1,268 @@
+#include "GpuProfiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+GpuProfiler::GpuProfiler(DeviceContext& deviceCtx, uint32_t framesInFlight, const std::string& csvPath, size_t historySize)
+    : m_deviceCtx(deviceCtx), m_historySize(historySize) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_deviceCtx.m_physicalDevice, &properties);
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    m_statisticsSupported = m_deviceCtx.m_pipelineStatisticsEnabled;
+
+    createPassQueries(
+        GpuPass::Compute, framesInFlight,
+        m_deviceCtx.m_computeQueueCtx.queueFamilyIndex,
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT
+    );
+
+    createPassQueries(
+        GpuPass::Graphics, framesInFlight,
+        m_deviceCtx.m_graphicsQueueCtx.queueFamilyIndex,
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+    );
+
+    if (!csvPath.empty()) {
+        m_csv.open(csvPath);
+        if (!m_csv.is_open()) {
+            throw std::runtime_error("failed to open profiler csv! " + csvPath);
+        }
+        m_csv << "frame,pass,ms,statistic\n";
+    }
+}
+
+GpuProfiler::~GpuProfiler() {
+    for (auto& pass : m_passes) {
+        for (auto& queries : pass.frames) {
+            if (queries.timestampPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(m_deviceCtx.m_logicalDevice, queries.timestampPool, nullptr);
+            }
+            if (queries.statisticsPool != VK_NULL_HANDLE) {
+                vkDestroyQueryPool(m_deviceCtx.m_logicalDevice, queries.statisticsPool, nullptr);
+            }
+        }
+    }
+}
+
+void GpuProfiler::createPassQueries(GpuPass pass, uint32_t framesInFlight, uint32_t queueFamilyIndex, VkQueryPipelineStatisticFlags statistics) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_deviceCtx.m_physicalDevice, &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_deviceCtx.m_physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    PassState& state = getPass(pass);
+
+    // Queues without valid timestamp bits simply don't get timed
+    uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+    if (validBits == 0) {
+        std::cout << "Profiler: " << getPassName(pass) << " queue doesn't support timestamps\n";
+    }
+    state.timestampMask = validBits >= 64 ? UINT64_MAX : ((uint64_t(1) << validBits) - 1);
+
+    state.frames.resize(framesInFlight);
+    for (auto& queries : state.frames) {
+        if (validBits != 0) {
+            VkQueryPoolCreateInfo timestampInfo{};
+            timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            timestampInfo.queryCount = TIMESTAMP_QUERY_COUNT;
+
+            if (vkCreateQueryPool(m_deviceCtx.m_logicalDevice, &timestampInfo, nullptr, &queries.timestampPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create timestamp query pool!");
+            }
+        }
+
+        if (m_statisticsSupported) {
+            VkQueryPoolCreateInfo statisticsInfo{};
+            statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsInfo.queryCount = 1;
+            statisticsInfo.pipelineStatistics = statistics;
+
+            if (vkCreateQueryPool(m_deviceCtx.m_logicalDevice, &statisticsInfo, nullptr, &queries.statisticsPool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create pipeline statistics query pool!");
+            }
+        }
+    }
+}
+
+void GpuProfiler::collect(GpuPass pass, uint32_t frame) {
+    PassState& state = getPass(pass);
+    PassQueries& queries = state.frames[frame];
+
+    if (!queries.pending) {
+        return;
+    }
+    queries.pending = false;
+
+    double ms = -1.0;
+    if (queries.timestampPool != VK_NULL_HANDLE) {
+        // Value + availability per query
+        std::array<uint64_t, TIMESTAMP_QUERY_COUNT * 2> timestamps{};
+        VkResult result = vkGetQueryPoolResults(
+            m_deviceCtx.m_logicalDevice, queries.timestampPool,
+            0, TIMESTAMP_QUERY_COUNT,
+            sizeof(timestamps), timestamps.data(), sizeof(uint64_t) * 2,
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+        );
+
+        if (result == VK_SUCCESS && timestamps[1] != 0 && timestamps[3] != 0) {
+            uint64_t begin = timestamps[0] & state.timestampMask;
+            uint64_t end = timestamps[2] & state.timestampMask;
+            ms = static_cast<double>((end - begin) & state.timestampMask) * m_timestampPeriod / 1000000.0;
+            pushSample(state.history, ms);
+        }
+    }
+
+    if (queries.statisticsPool != VK_NULL_HANDLE) {
+        std::array<uint64_t, 2> statistic{};
+        VkResult result = vkGetQueryPoolResults(
+            m_deviceCtx.m_logicalDevice, queries.statisticsPool,
+            0, 1,
+            sizeof(statistic), statistic.data(), sizeof(statistic),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT
+        );
+
+        if (result == VK_SUCCESS && statistic[1] != 0) {
+            state.lastStatistic = statistic[0];
+        }
+    }
+
+    if (m_csv.is_open() && ms >= 0.0) {
+        m_csv << queries.frameIndex << "," << getPassName(pass) << "," << ms << "," << state.lastStatistic << "\n";
+    }
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, GpuPass pass, uint32_t frame) {
+    PassQueries& queries = getPass(pass).frames[frame];
+
+    if (queries.timestampPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queries.timestampPool, 0, TIMESTAMP_QUERY_COUNT);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries.timestampPool, QUERY_BEGIN);
+    }
+
+    if (queries.statisticsPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queries.statisticsPool, 0, 1);
+        vkCmdBeginQuery(commandBuffer, queries.statisticsPool, 0, 0);
+    }
+}
+
+void GpuProfiler::end(VkCommandBuffer commandBuffer, GpuPass pass, uint32_t frame) {
+    PassQueries& queries = getPass(pass).frames[frame];
+
+    if (queries.statisticsPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, queries.statisticsPool, 0);
+    }
+
+    if (queries.timestampPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queries.timestampPool, QUERY_END);
+    }
+}
+
+void GpuProfiler::submitted(GpuPass pass, uint32_t frame) {
+    PassQueries& queries = getPass(pass).frames[frame];
+    queries.pending = true;
+    queries.frameIndex = m_frameIndex;
+}
+
+void GpuProfiler::clear() {
+    for (auto& pass : m_passes) {
+        pass.history.clear();
+        for (auto& queries : pass.frames) {
+            queries.pending = false;
+        }
+    }
+    m_frameTimes.clear();
+}
+
+void GpuProfiler::addFrameTime(double frameMs) {
+    pushSample(m_frameTimes, frameMs);
+
+    if (m_csv.is_open()) {
+        m_csv << m_frameIndex << ",frame," << frameMs << ",0\n";
+    }
+
+    m_frameIndex++;
+}
+
+GpuPassStats GpuProfiler::getStats(GpuPass pass) const {
+    return computeStats(getPass(pass).history);
+}
+
+GpuPassStats GpuProfiler::getFrameTimeStats() const {
+    return computeStats(m_frameTimes);
+}
+
+uint64_t GpuProfiler::getLastStatistic(GpuPass pass) const {
+    return getPass(pass).lastStatistic;
+}
+
+void GpuProfiler::printSummary() const {
+    auto printStats = [](const char* name, const GpuPassStats& stats) {
+        std::cout << std::fixed << std::setprecision(3)
+                  << name << ": avg " << stats.averageMs << " ms"
+                  << " | p50 " << stats.p50Ms
+                  << " | p95 " << stats.p95Ms
+                  << " | p99 " << stats.p99Ms
+                  << " | max " << stats.maxMs
+                  << " (" << stats.samples << " samples)\n";
+        std::cout << std::defaultfloat;
+    };
+
+    std::cout << "Profiler summary (last " << m_historySize << " frames) -v-\n";
+    printStats("Compute ", getStats(GpuPass::Compute));
+    printStats("Graphics", getStats(GpuPass::Graphics));
+    printStats("Frame   ", getFrameTimeStats());
+
+    if (m_statisticsSupported) {
+        std::cout << "Compute invocations: " << getLastStatistic(GpuPass::Compute) << "\n";
+        std::cout << "Vertices: " << getLastStatistic(GpuPass::Graphics) << "\n";
+    }
+}
+
+GpuProfiler::PassState& GpuProfiler::getPass(GpuPass pass) {
+    return m_passes[static_cast<size_t>(pass)];
+}
+
+const GpuProfiler::PassState& GpuProfiler::getPass(GpuPass pass) const {
+    return m_passes[static_cast<size_t>(pass)];
+}
+
+void GpuProfiler::pushSample(std::deque<double>& history, double value) {
+    history.push_back(value);
+    if (history.size() > m_historySize) {
+        history.pop_front();
+    }
+}
+
+GpuPassStats GpuProfiler::computeStats(const std::deque<double>& history) {
+    GpuPassStats stats{};
+    if (history.empty()) {
+        return stats;
+    }
+
+    std::vector<double> sorted(history.begin(), history.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    auto percentile = [&](double p) {
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    };
+
+    stats.samples = static_cast<uint32_t>(sorted.size());
+    stats.averageMs = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+    stats.p50Ms = percentile(0.50);
+    stats.p95Ms = percentile(0.95);
+    stats.p99Ms = percentile(0.99);
+    stats.maxMs = sorted.back();
+
+    return stats;
+}
+
+const char* GpuProfiler::getPassName(GpuPass pass) {
+    return pass == GpuPass::Compute ? "compute" : "graphics";
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+
+enum class GpuPass {
+    Compute,
+    Graphics,
+};
+
+struct GpuPassStats {
+    uint32_t samples = 0;
+    double averageMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+// Times the compute and graphics passes with timestamp queries (plus pipeline statistics where the
+// device supports them). Every frame in flight gets its own query pools, and a pool is only read back
+// once its frame slot was waited on, so collecting never stalls the CPU.
+// Per pass usage, for the frame slot being recorded:
+//   collect() right after the frame slot wait, begin()/end() around the work in the command buffer and
+//   submitted() whenever that command buffer is submitted, which can be many times if it's replayed
+class GpuProfiler {
+public:
+    GpuProfiler(DeviceContext& deviceCtx, uint32_t framesInFlight, const std::string& csvPath = "", size_t historySize = 512);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void collect(GpuPass pass, uint32_t frame);
+
+    // Must be recorded outside of a render pass
+    void begin(VkCommandBuffer commandBuffer, GpuPass pass, uint32_t frame);
+    void end(VkCommandBuffer commandBuffer, GpuPass pass, uint32_t frame);
+
+    void submitted(GpuPass pass, uint32_t frame);
+
+    // Drops every sample so far, including the ones still in flight
+    void clear();
+
+    // Wall clock frame time, so presentation/CPU overhead shows up next to the GPU passes
+    void addFrameTime(double frameMs);
+
+    GpuPassStats getStats(GpuPass pass) const;
+    GpuPassStats getFrameTimeStats() const;
+
+    // Latest pipeline statistics, compute shader invocations and input assembly vertices
+    uint64_t getLastStatistic(GpuPass pass) const;
+
+    void printSummary() const;
+
+private:
+    static constexpr uint32_t QUERY_BEGIN = 0;
+    static constexpr uint32_t QUERY_END = 1;
+    static constexpr uint32_t TIMESTAMP_QUERY_COUNT = 2;
+
+    struct PassQueries {
+        VkQueryPool timestampPool = VK_NULL_HANDLE;
+        VkQueryPool statisticsPool = VK_NULL_HANDLE;
+
+        // Written by a submitted command buffer and not read back yet
+        bool pending = false;
+        uint64_t frameIndex = 0;
+    };
+
+    struct PassState {
+        std::vector<PassQueries> frames;
+        uint64_t timestampMask = 0;
+        std::deque<double> history;
+        uint64_t lastStatistic = 0;
+    };
+
+    DeviceContext& m_deviceCtx;
+
+    // Only the latest frames go into the rolling stats
+    size_t m_historySize;
+
+    float m_timestampPeriod = 1.0f;
+    bool m_statisticsSupported = false;
+
+    std::array<PassState, 2> m_passes;
+    std::deque<double> m_frameTimes;
+
+    uint64_t m_frameIndex = 0;
+    std::ofstream m_csv;
+
+    PassState& getPass(GpuPass pass);
+    const PassState& getPass(GpuPass pass) const;
+
+    void createPassQueries(GpuPass pass, uint32_t framesInFlight, uint32_t queueFamilyIndex, VkQueryPipelineStatisticFlags statistics);
+    void pushSample(std::deque<double>& history, double value);
+
+    static GpuPassStats computeStats(const std::deque<double>& history);
+    static const char* getPassName(GpuPass pass);
+};
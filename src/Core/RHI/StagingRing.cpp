@@ -0,0 +1,228 @@
+#include "StagingRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "Core/RHI/DeviceContext.hpp"
+
+StagingRing::StagingRing(DeviceContext& deviceCtx, VkDeviceSize capacity) : m_deviceCtx(deviceCtx), m_capacity(capacity) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(m_deviceCtx.m_logicalDevice, &bufferInfo, nullptr, &m_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create staging ring buffer!");
+    }
+
+    // Host visible memory comes back persistently mapped
+    m_allocation = m_deviceCtx.m_memoryAllocator->allocateForBuffer(
+        m_buffer,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+    );
+    m_mapped = static_cast<char*>(m_allocation.mapped);
+}
+
+StagingRing::~StagingRing() {
+    waitIdle();
+
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+    for (const auto& batch : m_freeBatches) {
+        vkFreeCommandBuffers(device, batch.queueCtx->mainCmdPool, 1, &batch.commandBuffer);
+        vkDestroyFence(device, batch.fence, nullptr);
+    }
+
+    vkDestroyBuffer(device, m_buffer, nullptr);
+    m_deviceCtx.m_memoryAllocator->free(m_allocation);
+}
+
+void StagingRing::uploadToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, const QueueContext& queueCtx) {
+    const char* src = static_cast<const char*>(data);
+
+    // Big uploads go in pieces, so the ring can cycle through them
+    VkDeviceSize uploaded = 0;
+    while (uploaded < size) {
+        VkDeviceSize pieceSize = std::min(size - uploaded, getMaxAllocationSize());
+
+        StagingAllocation allocation = allocate(pieceSize, queueCtx);
+        std::memcpy(allocation.data, src + uploaded, pieceSize);
+        copyToBuffer(allocation, dst, dstOffset + uploaded);
+
+        uploaded += pieceSize;
+    }
+}
+
+StagingAllocation StagingRing::allocate(VkDeviceSize size, const QueueContext& queueCtx) {
+    if (size > getMaxAllocationSize()) {
+        throw std::runtime_error("staging allocation is bigger than the ring allows!");
+    }
+
+    // A batch only ever targets one queue
+    if (m_hasOpenBatch && m_openBatch.queueCtx != &queueCtx) {
+        flush();
+    }
+
+    uint64_t start = 0;
+    while (true) {
+        start = (m_head + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        // Regions never wrap around the end of the buffer
+        if (start % m_capacity + size > m_capacity) {
+            start = (start / m_capacity + 1) * m_capacity;
+        }
+
+        if (start + size - m_tail <= m_capacity) {
+            break;
+        }
+
+        retireCompleted();
+        if (start + size - m_tail <= m_capacity) {
+            break;
+        }
+
+        // Full, the space we need may be sitting in our own open batch
+        if (m_hasOpenBatch) {
+            flush();
+        }
+        waitOldest();
+    }
+
+    if (!m_hasOpenBatch) {
+        openBatch(queueCtx);
+    }
+
+    m_head = start + size;
+    m_openBatch.ringEnd = m_head;
+
+    StagingAllocation allocation{};
+    allocation.data = m_mapped + start % m_capacity;
+    allocation.buffer = m_buffer;
+    allocation.offset = start % m_capacity;
+    allocation.size = size;
+    return allocation;
+}
+
+void StagingRing::copyToBuffer(const StagingAllocation& allocation, VkBuffer dst, VkDeviceSize dstOffset) {
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = allocation.offset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = allocation.size;
+
+    vkCmdCopyBuffer(m_openBatch.commandBuffer, m_buffer, dst, 1, &copyRegion);
+}
+
+VkDeviceSize StagingRing::getMaxAllocationSize() const {
+    return m_capacity / 2;
+}
+
+void StagingRing::flush() {
+    if (!m_hasOpenBatch) {
+        return;
+    }
+
+    // Later submissions on this queue see the copied data without needing their own barriers
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        m_openBatch.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr
+    );
+
+    if (vkEndCommandBuffer(m_openBatch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record staging command buffer!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &m_openBatch.commandBuffer;
+
+    if (vkQueueSubmit(m_openBatch.queueCtx->queue, 1, &submitInfo, m_openBatch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit staging command buffer!");
+    }
+
+    m_inFlight.push_back(m_openBatch);
+    m_hasOpenBatch = false;
+}
+
+void StagingRing::waitIdle() {
+    flush();
+    while (!m_inFlight.empty()) {
+        waitOldest();
+    }
+}
+
+void StagingRing::openBatch(const QueueContext& queueCtx) {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    auto reusable = std::find_if(m_freeBatches.begin(), m_freeBatches.end(), [&](const Batch& batch) {
+        return batch.queueCtx == &queueCtx;
+    });
+
+    if (reusable != m_freeBatches.end()) {
+        m_openBatch = *reusable;
+        m_freeBatches.erase(reusable);
+
+        vkResetFences(device, 1, &m_openBatch.fence);
+        vkResetCommandBuffer(m_openBatch.commandBuffer, 0);
+    } else {
+        m_openBatch = Batch{};
+        m_openBatch.queueCtx = &queueCtx;
+
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = queueCtx.mainCmdPool;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, &m_openBatch.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate staging command buffer!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkCreateFence(device, &fenceInfo, nullptr, &m_openBatch.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging fence!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(m_openBatch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin staging command buffer!");
+    }
+
+    m_hasOpenBatch = true;
+}
+
+void StagingRing::retireCompleted() {
+    while (!m_inFlight.empty() && vkGetFenceStatus(m_deviceCtx.m_logicalDevice, m_inFlight.front().fence) == VK_SUCCESS) {
+        m_tail = m_inFlight.front().ringEnd;
+        m_freeBatches.push_back(m_inFlight.front());
+        m_inFlight.pop_front();
+    }
+
+    // Nothing left in flight or open, start over from the beginning of the buffer
+    if (m_inFlight.empty() && !m_hasOpenBatch) {
+        m_head = 0;
+        m_tail = 0;
+    }
+}
+
+void StagingRing::waitOldest() {
+    if (m_inFlight.empty()) {
+        return;
+    }
+
+    vkWaitForFences(m_deviceCtx.m_logicalDevice, 1, &m_inFlight.front().fence, VK_TRUE, UINT64_MAX);
+    retireCompleted();
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceMemoryAllocator.hpp"
+#include "Core/RHI/Types/AppTypes.hpp"
+
+class DeviceContext;
+
+// Ring space handed out for the caller to fill, valid until the next allocate/upload call
+struct StagingAllocation {
+    void* data = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+};
+
+// One persistently mapped host buffer that uploads are sub-allocated from in ring order.
+// Copies are recorded into an open batch (one command buffer) and only submitted on flush(),
+// every submitted batch owns a fence and its ring region is given back once that fence signals.
+// Uploads never allocate or wait, unless the ring is full and has to wait for the oldest batch.
+class StagingRing {
+public:
+    StagingRing(DeviceContext& deviceCtx, VkDeviceSize capacity);
+    ~StagingRing();
+
+    StagingRing(const StagingRing&) = delete;
+    StagingRing& operator=(const StagingRing&) = delete;
+
+    // Copies data into the ring and queues the copy into dst, submitted with the next flush()
+    void uploadToBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size, const QueueContext& queueCtx);
+
+    // Lower level pair for callers that generate data straight into staging memory,
+    // the copy must be queued before allocating again
+    StagingAllocation allocate(VkDeviceSize size, const QueueContext& queueCtx);
+    void copyToBuffer(const StagingAllocation& allocation, VkBuffer dst, VkDeviceSize dstOffset);
+
+    // Biggest single allocation, uploadToBuffer splits anything larger
+    VkDeviceSize getMaxAllocationSize() const;
+
+    // Submits the open batch, doesn't wait for it
+    void flush();
+
+    // Submits the open batch and waits for every batch in flight
+    void waitIdle();
+
+private:
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        const QueueContext* queueCtx = nullptr;
+
+        // Ring position right after this batch's last allocation
+        uint64_t ringEnd = 0;
+    };
+
+    static constexpr VkDeviceSize ALIGNMENT = 16;
+
+    DeviceContext& m_deviceCtx;
+
+    VkBuffer m_buffer = VK_NULL_HANDLE;
+    MemoryAllocation m_allocation;
+    char* m_mapped = nullptr;
+    VkDeviceSize m_capacity;
+
+    // Monotonic positions, the offset in the buffer is position % capacity
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+
+    bool m_hasOpenBatch = false;
+    Batch m_openBatch;
+    std::deque<Batch> m_inFlight;
+
+    // Retired batches, reused so steady state uploads don't allocate command buffers or fences
+    std::vector<Batch> m_freeBatches;
+
+    void openBatch(const QueueContext& queueCtx);
+    void retireCompleted();
+    void waitOldest();
+};
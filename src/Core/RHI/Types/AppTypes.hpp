@@ -2,33 +2,111 @@
 
 #include <vulkan/vulkan.h>
 
+#include <array>
+#include <cstring>
+#include <vector>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+// Per-step compute parameters, must match shaders/include/simulation_params.glsl (std140)
+struct SimulationParams {
+    float deltaTime = 0.0f;
+    uint32_t seed = 0;
+    uint32_t stepIndex = 0;
+
+    float gravity = 0.0f;
+    float airResist = 0.0f;
+    float resetSpeedThreshold = 0.0f;
+    float launchStrength = 0.0f;
+
+    float particleRadius = 0.0f;
+    float restitution = 0.0f;
+
+    float attraction = 0.0f;
+    float softening = 0.0f;
+    uint32_t useMass = 0;
+
+    float openingAngle = 0.0f;
+
+    uint32_t emitCount = 0;
+};
+
 
-struct UniformBufferObject {
-    float deltaTime = 1.0f;
+enum class ParticleLayout {
+    AoS, // One interleaved Particle record per particle
+    SoA, // Position, velocity and color each in their own stream
 };
 
-struct rngUbo {
-    float value = 0;
+enum class ParticleEncoding {
+    Precise, // fp32 everything, 32 bytes per particle
+    Compact, // fp32 position, half2 velocity and unorm4x8 color, 16 bytes per particle
 };
 
+// One buffer worth of particle attributes
+struct ParticleStream {
+    uint32_t stride;
+
+    // Rewritten by the compute kernels every step, so it's double buffered and bound as an in/out pair,
+    // otherwise it's only written at spawn and both frames share it
+    bool simulated;
+    uint32_t inBinding;
+    uint32_t outBinding;
+};
+
+// GPU side record of the compact AoS encoding
+struct CompactParticle {
+    glm::vec2 position;
+    uint32_t velocity; // packHalf2x16
+    uint32_t color;    // packUnorm4x8
+};
 
 struct Particle {
     glm::vec2 position;
     glm::vec2 velocity;
     glm::vec4 color;
 
-    static VkVertexInputBindingDescription getBindingDescription() {
-        VkVertexInputBindingDescription bindingDescription{};
-        bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Particle);
-        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    // Must match shaders/include/particle_layout.glsl
+    static std::vector<ParticleStream> getStreams(ParticleLayout layout, ParticleEncoding encoding) {
+        bool compact = encoding == ParticleEncoding::Compact;
+
+        if (layout == ParticleLayout::SoA) {
+            uint32_t velocityStride = compact ? sizeof(uint32_t) : sizeof(glm::vec2);
+            uint32_t colorStride = compact ? sizeof(uint32_t) : sizeof(glm::vec4);
+
+            return {
+                { sizeof(glm::vec2), true, 1, 2 }, // position
+                { velocityStride, true, 4, 5 },    // velocity
+                { colorStride, false, 0, 0 },      // color
+            };
+        }
+
+        uint32_t particleStride = compact ? sizeof(CompactParticle) : sizeof(Particle);
+        return { { particleStride, true, 1, 2 } };
+    }
+
+    // Every stream is bound as a vertex buffer at the binding matching its index, the ones the
+    // vertex shader doesn't read (SoA velocity) simply get no description
+    static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(ParticleLayout layout, ParticleEncoding encoding) {
+        std::vector<ParticleStream> streams = getStreams(layout, encoding);
+        std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+
+        for (const auto& attribute : getAttributeDescriptions(layout, encoding)) {
+            VkVertexInputBindingDescription bindingDescription{};
+            bindingDescription.binding = attribute.binding;
+            bindingDescription.stride = streams[attribute.binding].stride;
+            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+            if (bindingDescriptions.empty() || bindingDescriptions.back().binding != bindingDescription.binding) {
+                bindingDescriptions.push_back(bindingDescription);
+            }
+        }
 
-        return bindingDescription;
+        return bindingDescriptions;
     }
 
-    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions() {
+    static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions(ParticleLayout layout, ParticleEncoding encoding) {
         std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
 
         attributeDescriptions[0].binding = 0;
@@ -41,8 +119,109 @@ struct Particle {
         attributeDescriptions[1].format = VK_FORMAT_R32G32B32A32_SFLOAT;
         attributeDescriptions[1].offset = offsetof(Particle, color);
 
+        // The vertex fetch unpacks the unorm4x8 color back into a vec4 on its own
+        if (encoding == ParticleEncoding::Compact) {
+            attributeDescriptions[0].offset = offsetof(CompactParticle, position);
+            attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+            attributeDescriptions[1].offset = offsetof(CompactParticle, color);
+        }
+
+        if (layout == ParticleLayout::SoA) {
+            attributeDescriptions[0].offset = 0;
+            attributeDescriptions[1].binding = 2;
+            attributeDescriptions[1].offset = 0;
+        }
+
         return attributeDescriptions;
     }
+
+    // Writes the given stream of the layout for every particle into dst
+    static void encodeStream(ParticleLayout layout, ParticleEncoding encoding, size_t stream, const std::vector<Particle>& particles, void* dst) {
+        uint32_t stride = getStreams(layout, encoding)[stream].stride;
+        char* out = static_cast<char*>(dst);
+
+        if (layout == ParticleLayout::AoS && encoding == ParticleEncoding::Precise) {
+            std::memcpy(dst, particles.data(), sizeof(Particle) * particles.size());
+            return;
+        }
+
+        for (const auto& particle : particles) {
+            encodeParticle(layout, encoding, stream, particle, out);
+            out += stride;
+        }
+    }
+
+    // A single particle's part of the given stream, stride bytes at dst
+    static void encodeParticle(ParticleLayout layout, ParticleEncoding encoding, size_t stream, const Particle& particle, void* dst) {
+        if (encoding == ParticleEncoding::Compact) {
+            CompactParticle compact{};
+            compact.position = particle.position;
+            compact.velocity = glm::packHalf2x16(particle.velocity);
+            compact.color = glm::packUnorm4x8(particle.color);
+
+            if (layout == ParticleLayout::AoS) {
+                std::memcpy(dst, &compact, sizeof(compact));
+            } else {
+                switch (stream) {
+                    case 0: std::memcpy(dst, &compact.position, sizeof(compact.position)); break;
+                    case 1: std::memcpy(dst, &compact.velocity, sizeof(compact.velocity)); break;
+                    case 2: std::memcpy(dst, &compact.color, sizeof(compact.color)); break;
+                }
+            }
+        } else if (layout == ParticleLayout::AoS) {
+            std::memcpy(dst, &particle, sizeof(particle));
+        } else {
+            switch (stream) {
+                case 0: std::memcpy(dst, &particle.position, sizeof(particle.position)); break;
+                case 1: std::memcpy(dst, &particle.velocity, sizeof(particle.velocity)); break;
+                case 2: std::memcpy(dst, &particle.color, sizeof(particle.color)); break;
+            }
+        }
+    }
+
+    // The reverse of encodeStream, fills in the stream's attributes of every particle from src
+    static void decodeStream(ParticleLayout layout, ParticleEncoding encoding, size_t stream, const void* src, std::vector<Particle>& particles) {
+        uint32_t stride = getStreams(layout, encoding)[stream].stride;
+        const char* in = static_cast<const char*>(src);
+
+        if (layout == ParticleLayout::AoS && encoding == ParticleEncoding::Precise) {
+            std::memcpy(particles.data(), src, sizeof(Particle) * particles.size());
+            return;
+        }
+
+        for (auto& particle : particles) {
+            if (encoding == ParticleEncoding::Compact) {
+                CompactParticle compact{};
+
+                if (layout == ParticleLayout::AoS) {
+                    std::memcpy(&compact, in, sizeof(compact));
+                } else {
+                    switch (stream) {
+                        case 0: std::memcpy(&compact.position, in, sizeof(compact.position)); break;
+                        case 1: std::memcpy(&compact.velocity, in, sizeof(compact.velocity)); break;
+                        case 2: std::memcpy(&compact.color, in, sizeof(compact.color)); break;
+                    }
+                }
+
+                if (layout == ParticleLayout::AoS || stream == 0) {
+                    particle.position = compact.position;
+                }
+                if (layout == ParticleLayout::AoS || stream == 1) {
+                    particle.velocity = glm::unpackHalf2x16(compact.velocity);
+                }
+                if (layout == ParticleLayout::AoS || stream == 2) {
+                    particle.color = glm::unpackUnorm4x8(compact.color);
+                }
+            } else {
+                switch (stream) {
+                    case 0: std::memcpy(&particle.position, in, sizeof(particle.position)); break;
+                    case 1: std::memcpy(&particle.velocity, in, sizeof(particle.velocity)); break;
+                    case 2: std::memcpy(&particle.color, in, sizeof(particle.color)); break;
+                }
+            }
+            in += stride;
+        }
+    }
 };
 
 struct SwapChainSupportDetails {
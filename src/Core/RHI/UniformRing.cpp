@@ -0,0 +1,42 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+UniformRing::UniformRing(DeviceContext& deviceCtx, uint32_t frameCount, VkDeviceSize frameSize) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(deviceCtx.m_physicalDevice, &properties);
+
+    m_alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+    m_frameSize = (frameSize + m_alignment - 1) / m_alignment * m_alignment;
+
+    m_buffer = std::make_unique<GpuBuffer>(
+        deviceCtx,
+        m_frameSize * frameCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        deviceCtx.m_computeQueueCtx
+    );
+}
+
+void UniformRing::beginFrame(uint32_t frame) {
+    m_frameBegin = m_frameSize * frame;
+    m_cursor = m_frameBegin;
+}
+
+uint32_t UniformRing::push(const void* data, VkDeviceSize size) {
+    VkDeviceSize offset = (m_cursor + m_alignment - 1) / m_alignment * m_alignment;
+
+    if (offset + size > m_frameBegin + m_frameSize) {
+        throw std::runtime_error("uniform ring frame slice is full!");
+    }
+
+    m_buffer->writeMapped(data, size, offset);
+    m_cursor = offset + size;
+
+    return static_cast<uint32_t>(offset);
+}
+
+const GpuBuffer& UniformRing::getBuffer() const {
+    return *m_buffer;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Per-frame uniform data packed into one persistently mapped buffer, one slice per frame in flight.
+// Each push() lands at the next minUniformBufferOffsetAlignment boundary of the current frame's
+// slice and returns the dynamic offset to bind it with, so descriptor sets point at the ring once
+// (as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC) and never get rewritten.
+class UniformRing {
+public:
+    UniformRing(DeviceContext& deviceCtx, uint32_t frameCount, VkDeviceSize frameSize);
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Starts writing over the frame's slice, the GPU must be done with it
+    void beginFrame(uint32_t frame);
+
+    uint32_t push(const void* data, VkDeviceSize size);
+
+    template <typename T>
+    uint32_t push(const T& data) {
+        return push(&data, sizeof(T));
+    }
+
+    const GpuBuffer& getBuffer() const;
+
+private:
+    std::unique_ptr<GpuBuffer> m_buffer;
+
+    VkDeviceSize m_alignment;
+    VkDeviceSize m_frameSize;
+
+    VkDeviceSize m_frameBegin = 0;
+    VkDeviceSize m_cursor = 0;
+};
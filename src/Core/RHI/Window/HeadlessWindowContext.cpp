@@ -0,0 +1,33 @@
+#include "HeadlessWindowContext.hpp"
+
+HeadlessWindowContext::HeadlessWindowContext(uint32_t width, uint32_t height, uint64_t frameCount)
+    : m_width(width), m_height(height), m_frameCount(frameCount), m_startTime(std::chrono::steady_clock::now()) {
+}
+
+std::vector<const char*> HeadlessWindowContext::getRequiredExtensions() {
+    return {};
+}
+
+void HeadlessWindowContext::createSurface(VkInstance, VkSurfaceKHR &surface) {
+    surface = VK_NULL_HANDLE;
+}
+
+void HeadlessWindowContext::getFramebufferSize(uint32_t &width, uint32_t &height) {
+    width = m_width;
+    height = m_height;
+}
+
+void HeadlessWindowContext::waitEvents() {
+}
+
+void HeadlessWindowContext::update() {
+    m_currentFrame++;
+}
+
+bool HeadlessWindowContext::shouldClose() {
+    return m_currentFrame >= m_frameCount;
+}
+
+double HeadlessWindowContext::getTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+}
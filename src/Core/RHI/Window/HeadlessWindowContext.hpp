@@ -0,0 +1,35 @@
+#pragma  once
+
+#include "WindowContext.hpp"
+
+#include <chrono>
+#include <vector>
+
+// Stands in for a window when there's no display, there's no surface to create and it
+// "closes" itself after a fixed amount of frames so the main loop runs N steps and returns
+class HeadlessWindowContext: public WindowContext {
+public:
+    HeadlessWindowContext(uint32_t width, uint32_t height, uint64_t frameCount);
+
+    std::vector<const char*> getRequiredExtensions() override;
+
+    void createSurface(VkInstance instance, VkSurfaceKHR &surface) override;
+
+    void getFramebufferSize(uint32_t &width, uint32_t &height) override;
+
+    void waitEvents() override;
+
+    void update() override;
+    
+    bool shouldClose() override;
+
+    double getTime() override;
+
+private:
+    uint32_t m_width, m_height;
+
+    uint64_t m_frameCount;
+    uint64_t m_currentFrame = 0;
+
+    std::chrono::steady_clock::time_point m_startTime;
+};
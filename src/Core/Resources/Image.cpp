@@ -39,19 +39,7 @@ Image::Image(
         throw std::runtime_error("failed to create image!");
     }
 
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(m_deviceCtx->m_logicalDevice, m_vkImage, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = m_deviceCtx->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(m_deviceCtx->m_logicalDevice, &allocInfo, nullptr, &m_imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(m_deviceCtx->m_logicalDevice, m_vkImage, m_imageMemory, 0);
+    m_imageMemory = m_deviceCtx->m_memoryAllocator->allocateForImage(m_vkImage, properties);
 
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -79,7 +67,7 @@ Image::Image(Image&& other) noexcept : m_deviceCtx(other.m_deviceCtx) {
 
     other.m_vkImage = VK_NULL_HANDLE;
     other.m_imageView = VK_NULL_HANDLE;
-    other.m_imageMemory = VK_NULL_HANDLE;
+    other.m_imageMemory = MemoryAllocation{};
 }
 
 Image& Image::operator=(Image&& other) noexcept {
@@ -96,7 +84,7 @@ Image& Image::operator=(Image&& other) noexcept {
 
         other.m_vkImage = VK_NULL_HANDLE;
         other.m_imageView = VK_NULL_HANDLE;
-        other.m_imageMemory = VK_NULL_HANDLE;
+        other.m_imageMemory = MemoryAllocation{};
     }
     
     return *this;
@@ -111,7 +99,7 @@ void Image::destroy() {
         VkDevice device = m_deviceCtx->m_logicalDevice;
         if (m_imageView) vkDestroyImageView(device, m_imageView, nullptr);
         if (m_vkImage) vkDestroyImage(device, m_vkImage, nullptr);
-        if (m_imageMemory) vkFreeMemory(device, m_imageMemory, nullptr);
+        m_deviceCtx->m_memoryAllocator->free(m_imageMemory);
     }
 }
 
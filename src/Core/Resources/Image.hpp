@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 #include "Core/RHI/Types/AppTypes.hpp"
 #include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/DeviceMemoryAllocator.hpp"
 #include "Barrier.hpp"
 
 class Image {
@@ -30,7 +31,7 @@ public:
     
     VkImage m_vkImage;
     VkImageView m_imageView;
-    VkDeviceMemory m_imageMemory;
+    MemoryAllocation m_imageMemory;
 
     uint32_t m_mipLevels, m_width, m_height;
     
@@ -0,0 +1,222 @@
+#include "BarnesHutTree.hpp"
+
+#include <array>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t TREE_BINDING_COUNT = 7;
+
+    void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void recordComputeToCompute(VkCommandBuffer commandBuffer) {
+        recordBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        );
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+BarnesHutTree::BarnesHutTree(DeviceContext& deviceCtx, uint32_t particleCount, uint32_t workgroupSize, ScanPath scanPath, const std::string& shaderDir)
+    : m_deviceCtx(deviceCtx), m_particleCount(particleCount), m_workgroupSize(workgroupSize), m_shaderDir(shaderDir) {
+    if (particleCount < 2) {
+        throw std::runtime_error("the tree needs at least two particles!");
+    }
+
+    m_sort = std::make_unique<RadixSort>(deviceCtx, particleCount, workgroupSize, scanPath, shaderDir);
+
+    createBuffers();
+    createDescriptors();
+}
+
+BarnesHutTree::~BarnesHutTree() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_mortonPipeline, nullptr);
+    vkDestroyPipeline(device, m_buildPipeline, nullptr);
+    vkDestroyPipeline(device, m_summarizePipeline, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+VkDescriptorSetLayout BarnesHutTree::getDescriptorSetLayout() const {
+    return m_descriptorSetLayout;
+}
+
+VkDescriptorSet BarnesHutTree::getDescriptorSet() const {
+    return m_descriptorSet;
+}
+
+uint32_t BarnesHutTree::getNodeCount() const {
+    return 2 * m_particleCount - 1;
+}
+
+void BarnesHutTree::createBuffers() {
+    VkDeviceSize internalCount = m_particleCount - 1;
+    VkDeviceSize nodeCount = getNodeCount();
+
+    auto createBuffer = [&](VkDeviceSize size, VkBufferUsageFlags extraUsage) {
+        return std::make_unique<GpuBuffer>(
+            m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx.m_computeQueueCtx
+        );
+    };
+
+    // The root's parent and the visit counters are reset with vkCmdFillBuffer before every build
+    m_nodeChildren = createBuffer(internalCount * 2 * sizeof(uint32_t), 0);
+    m_nodeParents = createBuffer(nodeCount * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_nodeBodies = createBuffer(nodeCount * 4 * sizeof(float), 0);
+    m_nodeBounds = createBuffer(nodeCount * 4 * sizeof(float), 0);
+    m_nodeVisits = createBuffer(internalCount * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+}
+
+void BarnesHutTree::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::array<VkDescriptorSetLayoutBinding, TREE_BINDING_COUNT> bindings{};
+    for (uint32_t i = 0; i < TREE_BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = TREE_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate tree descriptor set!");
+    }
+
+    // Binding order must match shaders/include/tree.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, m_sort->getKeys());
+    writer.addStorageBufferBinding(m_descriptorSet, 1, m_sort->getValues());
+    writer.addStorageBufferBinding(m_descriptorSet, 2, *m_nodeChildren);
+    writer.addStorageBufferBinding(m_descriptorSet, 3, *m_nodeParents);
+    writer.addStorageBufferBinding(m_descriptorSet, 4, *m_nodeBodies);
+    writer.addStorageBufferBinding(m_descriptorSet, 5, *m_nodeBounds);
+    writer.addStorageBufferBinding(m_descriptorSet, 6, *m_nodeVisits);
+    writer.writeAll(device);
+}
+
+VkPipeline BarnesHutTree::createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create tree pipeline! " + path);
+    }
+
+    return pipeline;
+}
+
+void BarnesHutTree::createPipelines(VkPipelineLayout pipelineLayout) {
+    m_pipelineLayout = pipelineLayout;
+
+    // local_size_x_id = 0
+    VkSpecializationMapEntry workgroupSizeEntry{};
+    workgroupSizeEntry.constantID = 0;
+    workgroupSizeEntry.offset = 0;
+    workgroupSizeEntry.size = sizeof(uint32_t);
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &workgroupSizeEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &m_workgroupSize;
+
+    m_mortonPipeline = createPipeline(m_shaderDir + "/tree_morton.comp.spv", specializationInfo);
+    m_buildPipeline = createPipeline(m_shaderDir + "/tree_build.comp.spv", specializationInfo);
+    m_summarizePipeline = createPipeline(m_shaderDir + "/tree_summarize.comp.spv", specializationInfo);
+}
+
+void BarnesHutTree::recordBuild(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet) {
+    uint32_t particleGroups = divideRoundingUp(m_particleCount, m_workgroupSize);
+    uint32_t internalGroups = divideRoundingUp(m_particleCount - 1, m_workgroupSize);
+
+    // The last step's readers are done with the tree before it gets reset
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_nodeVisits->m_vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    vkCmdFillBuffer(commandBuffer, m_nodeParents->m_vkBuffer, 0, sizeof(uint32_t), 0xFFFFFFFF);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    auto bindSets = [&]() {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &particleSet, 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 2, 1, &m_descriptorSet, 0, nullptr);
+    };
+    bindSets();
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_mortonPipeline);
+    vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+    recordComputeToCompute(commandBuffer);
+
+    m_sort->recordSort(commandBuffer, m_particleCount);
+
+    // The sort went through its own pipeline layout
+    bindSets();
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_buildPipeline);
+    vkCmdDispatch(commandBuffer, internalGroups, 1, 1);
+    recordComputeToCompute(commandBuffer);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_summarizePipeline);
+    vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+    recordComputeToCompute(commandBuffer);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Compute/RadixSort.hpp"
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Linear BVH over the particles for Barnes-Hut gravity, built on the GPU every step (Karras 2012):
+//   tree_morton       Morton key of every particle
+//   RadixSort         sorts the keys, particle indices riding along
+//   tree_build        the binary radix tree over the sorted keys, one thread per internal node
+//   tree_summarize    mass, center of mass and bounds of every node, bottom up
+// The particles themselves stay where they are, the leaves point at them. The tree kernels share the
+// simulation's compute pipeline layout like the grid ones do (the sort has its own):
+//   set 0 particles in/out, set 1 step params, set 2 the tree
+class BarnesHutTree {
+public:
+    // scanPath is the sort's. shaderDir is the compiled variant directory
+    BarnesHutTree(DeviceContext& deviceCtx, uint32_t particleCount, uint32_t workgroupSize, ScanPath scanPath, const std::string& shaderDir);
+    ~BarnesHutTree();
+
+    BarnesHutTree(const BarnesHutTree&) = delete;
+    BarnesHutTree& operator=(const BarnesHutTree&) = delete;
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+    VkDescriptorSet getDescriptorSet() const;
+
+    // Internal nodes plus leaves
+    uint32_t getNodeCount() const;
+
+    // The layout is the simulation's compute pipeline layout
+    void createPipelines(VkPipelineLayout pipelineLayout);
+
+    // Builds the tree over the in buffers of particleSet. Leaves the tree visible to the compute shaders
+    // recorded after it, with the tree's descriptor set bound as set 2
+    void recordBuild(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet);
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_particleCount;
+    uint32_t m_workgroupSize;
+    std::string m_shaderDir;
+
+    // Holds the Morton keys and particle indices
+    std::unique_ptr<RadixSort> m_sort;
+
+    std::unique_ptr<GpuBuffer> m_nodeChildren;
+    std::unique_ptr<GpuBuffer> m_nodeParents;
+    std::unique_ptr<GpuBuffer> m_nodeBodies;
+    std::unique_ptr<GpuBuffer> m_nodeBounds;
+    std::unique_ptr<GpuBuffer> m_nodeVisits;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_mortonPipeline = VK_NULL_HANDLE;
+    VkPipeline m_buildPipeline = VK_NULL_HANDLE;
+    VkPipeline m_summarizePipeline = VK_NULL_HANDLE;
+
+    void createBuffers();
+    void createDescriptors();
+    VkPipeline createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo);
+};
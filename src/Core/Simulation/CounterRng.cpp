@@ -0,0 +1,35 @@
+#include "CounterRng.hpp"
+
+namespace {
+    constexpr uint32_t PHILOX_M0 = 0xD2511F53u;
+    constexpr uint32_t PHILOX_M1 = 0xCD9E8D57u;
+    constexpr uint32_t PHILOX_W0 = 0x9E3779B9u;
+    constexpr uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+    // umulExtended
+    void multiply(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo) {
+        uint64_t product = static_cast<uint64_t>(a) * b;
+        hi = static_cast<uint32_t>(product >> 32);
+        lo = static_cast<uint32_t>(product);
+    }
+}
+
+glm::uvec4 CounterRng::philox4x32(glm::uvec4 counter, glm::uvec2 key) {
+    for (int round = 0; round < 10; round++) {
+        uint32_t hi0, lo0, hi1, lo1;
+        multiply(PHILOX_M0, counter.x, hi0, lo0);
+        multiply(PHILOX_M1, counter.z, hi1, lo1);
+
+        counter = glm::uvec4(hi1 ^ counter.y ^ key.x, lo1, hi0 ^ counter.w ^ key.y, lo0);
+        key += glm::uvec2(PHILOX_W0, PHILOX_W1);
+    }
+    return counter;
+}
+
+glm::uvec4 CounterRng::bits(uint32_t seed, uint32_t stream, uint32_t index, uint32_t step, uint32_t salt) {
+    return philox4x32(glm::uvec4(index, step, salt, 0u), glm::uvec2(seed, stream));
+}
+
+glm::vec4 CounterRng::unit(uint32_t seed, uint32_t stream, uint32_t index, uint32_t step, uint32_t salt) {
+    return glm::vec4(bits(seed, stream, index, step, salt) >> 8u) * (1.0f / 16777216.0f);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+// CPU mirror of shaders/include/random.glsl, Philox4x32-10 keyed by (run seed, stream) over the
+// counter (particle index, step, salt). Same bits as the kernels, so any of their draws can be redone here
+class CounterRng {
+public:
+    // Must match the RNG_STREAM_ defines
+    enum Stream : uint32_t {
+        Initialize = 0,
+        Popcorn = 1,
+        Gravity = 2,
+        Emit = 3,
+    };
+
+    static glm::uvec4 philox4x32(glm::uvec4 counter, glm::uvec2 key);
+
+    static glm::uvec4 bits(uint32_t seed, uint32_t stream, uint32_t index, uint32_t step, uint32_t salt);
+
+    // Four floats in [0, 1), from the top 24 bits of each value
+    static glm::vec4 unit(uint32_t seed, uint32_t stream, uint32_t index, uint32_t step, uint32_t salt);
+};
@@ -0,0 +1,263 @@
+#include "MortonReorder.hpp"
+
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t REORDER_BINDING_COUNT = 3;
+    constexpr uint32_t COUNTER_COUNT = 2;
+
+    void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+MortonReorder::MortonReorder(
+    DeviceContext& deviceCtx,
+    uint32_t particleCount,
+    uint32_t workgroupSize,
+    uint32_t framesInFlight,
+    VkDescriptorSetLayout particleSetLayout,
+    ScanPath scanPath,
+    const std::string& shaderDir
+) : m_deviceCtx(deviceCtx), m_particleCount(particleCount), m_workgroupSize(workgroupSize), m_pending(framesInFlight, false) {
+    if (particleCount < 2) {
+        throw std::runtime_error("the Morton re-sort needs at least two particles!");
+    }
+
+    m_sort = std::make_unique<RadixSort>(deviceCtx, particleCount, workgroupSize, scanPath, shaderDir);
+
+    createBuffers(framesInFlight);
+    createDescriptors();
+    createPipelines(particleSetLayout, shaderDir);
+}
+
+MortonReorder::~MortonReorder() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_keysPipeline, nullptr);
+    vkDestroyPipeline(device, m_permutePipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+void MortonReorder::createBuffers(uint32_t framesInFlight) {
+    VkDeviceSize counterBytes = COUNTER_COUNT * sizeof(uint32_t);
+
+    // Reset with vkCmdFillBuffer before every sort
+    m_counters = std::make_unique<GpuBuffer>(
+        m_deviceCtx,
+        counterBytes,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_deviceCtx.m_computeQueueCtx
+    );
+
+    m_readback = std::make_unique<GpuBuffer>(
+        m_deviceCtx,
+        counterBytes * framesInFlight,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_deviceCtx.m_computeQueueCtx
+    );
+}
+
+void MortonReorder::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::array<VkDescriptorSetLayoutBinding, REORDER_BINDING_COUNT> bindings{};
+    for (uint32_t i = 0; i < REORDER_BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reorder descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = REORDER_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reorder descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate reorder descriptor set!");
+    }
+
+    // Binding order must match shaders/include/reorder.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, m_sort->getKeys());
+    writer.addStorageBufferBinding(m_descriptorSet, 1, m_sort->getValues());
+    writer.addStorageBufferBinding(m_descriptorSet, 2, *m_counters);
+    writer.writeAll(device);
+}
+
+VkPipeline MortonReorder::createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reorder pipeline! " + path);
+    }
+
+    return pipeline;
+}
+
+void MortonReorder::createPipelines(VkDescriptorSetLayout particleSetLayout, const std::string& shaderDir) {
+    std::array<VkDescriptorSetLayout, 2> setLayouts = { particleSetLayout, m_descriptorSetLayout };
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts = setLayouts.data();
+
+    if (vkCreatePipelineLayout(m_deviceCtx.m_logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reorder pipeline layout!");
+    }
+
+    // local_size_x_id = 0
+    VkSpecializationMapEntry workgroupSizeEntry{};
+    workgroupSizeEntry.constantID = 0;
+    workgroupSizeEntry.offset = 0;
+    workgroupSizeEntry.size = sizeof(uint32_t);
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &workgroupSizeEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &m_workgroupSize;
+
+    m_keysPipeline = createPipeline(shaderDir + "/reorder_keys.comp.spv", specializationInfo);
+    m_permutePipeline = createPipeline(shaderDir + "/reorder_permute.comp.spv", specializationInfo);
+}
+
+void MortonReorder::recordReorder(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet, uint32_t frame) {
+    uint32_t groupCount = divideRoundingUp(m_particleCount, m_workgroupSize);
+    VkDeviceSize counterBytes = COUNTER_COUNT * sizeof(uint32_t);
+
+    // The last sort's kernels and counter copy are done before the counters get reset
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_counters->m_vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    auto bindSets = [&]() {
+        std::array<VkDescriptorSet, 2> sets = { particleSet, m_descriptorSet };
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+    };
+    bindSets();
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_keysPipeline);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    m_sort->recordSort(commandBuffer, m_particleCount);
+
+    // The sort went through its own pipeline layout
+    bindSets();
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_permutePipeline);
+    vkCmdDispatch(commandBuffer, groupCount, 1, 1);
+
+    // The sorted particles go to the step, the counters to the host
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT
+    );
+
+    VkBufferCopy copyRegion{};
+    copyRegion.dstOffset = counterBytes * frame;
+    copyRegion.size = counterBytes;
+    vkCmdCopyBuffer(commandBuffer, m_counters->m_vkBuffer, m_readback->m_vkBuffer, 1, &copyRegion);
+
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT
+    );
+}
+
+void MortonReorder::submitted(uint32_t frame) {
+    m_pending[frame] = true;
+}
+
+void MortonReorder::collect(uint32_t frame) {
+    if (!m_pending[frame]) {
+        return;
+    }
+    m_pending[frame] = false;
+
+    uint32_t counters[COUNTER_COUNT];
+    std::memcpy(counters, static_cast<const char*>(m_readback->getMapped()) + sizeof(counters) * frame, sizeof(counters));
+
+    m_sorts++;
+    m_sameCellBefore += counters[0];
+    m_sameCellAfter += counters[1];
+}
+
+MortonReorderStats MortonReorder::getStats() const {
+    MortonReorderStats stats{};
+    stats.sorts = m_sorts;
+
+    if (m_sorts > 0) {
+        // Pairs of memory neighbors per sort
+        double pairs = static_cast<double>(m_sorts) * (m_particleCount - 1);
+        stats.sameCellBefore = m_sameCellBefore / pairs;
+        stats.sameCellAfter = m_sameCellAfter / pairs;
+    }
+
+    return stats;
+}
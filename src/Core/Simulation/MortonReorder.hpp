@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Compute/RadixSort.hpp"
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Locality of the particle order, measured on every re-sort
+struct MortonReorderStats {
+    uint32_t sorts = 0;
+
+    // Average fraction of particles sharing their 64x64 cell with the next one in memory, before and after
+    double sameCellBefore = 0.0;
+    double sameCellAfter = 0.0;
+};
+
+// Re-sorts the particles by the Morton code of their position every few frames, so particles close in
+// the box sit close in memory for the kernels and the rasterizer:
+//   reorder_keys      Morton key of every particle, and how many memory neighbors share a cell
+//   RadixSort         sorts the keys, particle indices riding along
+//   reorder_permute   gathers the particles in key order into the out buffers, and counts again
+// Has its own pipeline layout (set 0 the simulation's particle set, set 1 see shaders/include/reorder.glsl)
+// so it works next to the grid or tree kernels' set 2. The counters of a frame are copied to host memory
+// and only read back once the frame slot comes around again, nothing waits on them
+class MortonReorder {
+public:
+    // scanPath is the sort's. shaderDir is the compiled variant directory
+    MortonReorder(
+        DeviceContext& deviceCtx,
+        uint32_t particleCount,
+        uint32_t workgroupSize,
+        uint32_t framesInFlight,
+        VkDescriptorSetLayout particleSetLayout,
+        ScanPath scanPath,
+        const std::string& shaderDir
+    );
+    ~MortonReorder();
+
+    MortonReorder(const MortonReorder&) = delete;
+    MortonReorder& operator=(const MortonReorder&) = delete;
+
+    // Sorts the in buffers of particleSet into its out buffers, leaving them visible to the compute shaders
+    // recorded after it. Binds its own pipeline layout, anything else has to be bound again after
+    void recordReorder(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet, uint32_t frame);
+
+    // Same pattern as GpuProfiler: submitted() once a frame slot's reorder was submitted and
+    // collect() after waiting on that slot again
+    void submitted(uint32_t frame);
+    void collect(uint32_t frame);
+
+    MortonReorderStats getStats() const;
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_particleCount;
+    uint32_t m_workgroupSize;
+
+    // Holds the Morton keys and particle indices
+    std::unique_ptr<RadixSort> m_sort;
+
+    // sameCellBefore, sameCellAfter, and a copy of them per frame slot
+    std::unique_ptr<GpuBuffer> m_counters;
+    std::unique_ptr<GpuBuffer> m_readback;
+    std::vector<bool> m_pending;
+
+    uint32_t m_sorts = 0;
+    uint64_t m_sameCellBefore = 0;
+    uint64_t m_sameCellAfter = 0;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_keysPipeline = VK_NULL_HANDLE;
+    VkPipeline m_permutePipeline = VK_NULL_HANDLE;
+
+    void createBuffers(uint32_t framesInFlight);
+    void createDescriptors();
+    void createPipelines(VkDescriptorSetLayout particleSetLayout, const std::string& shaderDir);
+    VkPipeline createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo);
+};
@@ -0,0 +1,37 @@
+#include "NBodyReference.hpp"
+
+#include <cmath>
+
+namespace {
+    // Bounces off the [-1, 1] walls like the kernel, losing airResist of the speed
+    void bounce(float& position, float& velocity, float airResist) {
+        if (position < -1.0f) {
+            position = -1.0f;
+            velocity = std::abs(velocity) * airResist;
+        } else if (position > 1.0f) {
+            position = 1.0f;
+            velocity = -std::abs(velocity) * airResist;
+        }
+    }
+}
+
+Particle NBodyReference::step(const SimulationParams& params, const std::vector<Particle>& particles, size_t index) {
+    Particle self = particles[index];
+
+    float softening2 = params.softening * params.softening;
+    glm::vec2 acceleration(0.0f);
+
+    for (const auto& source : particles) {
+        float mass = params.useMass != 0 ? source.color.a : 1.0f;
+        glm::vec2 delta = source.position - self.position;
+        float inverseDistance = 1.0f / std::sqrt(glm::dot(delta, delta) + softening2);
+        acceleration += delta * (mass * inverseDistance * inverseDistance * inverseDistance);
+    }
+
+    self.velocity += acceleration * params.attraction * params.deltaTime;
+    self.position += self.velocity * params.deltaTime;
+
+    bounce(self.position.x, self.velocity.x, params.airResist);
+    bounce(self.position.y, self.velocity.y, params.airResist);
+    return self;
+}
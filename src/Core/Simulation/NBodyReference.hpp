@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "Core/RHI/Types/AppTypes.hpp"
+
+// CPU mirror of shaders/nbody.comp, slow (all pairs for a single particle) but only used to validate the kernel
+class NBodyReference {
+public:
+    // One step of particles[index] against every particle, same float math and order as the kernel
+    static Particle step(const SimulationParams& params, const std::vector<Particle>& particles, size_t index);
+};
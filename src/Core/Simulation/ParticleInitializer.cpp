@@ -0,0 +1,185 @@
+#include "ParticleInitializer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include "Core/Simulation/CounterRng.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+#define PARTICLE_INITIALIZER_AVX2
+#include <immintrin.h>
+#endif
+
+namespace {
+    constexpr uint32_t BATCH_SIZE = 8;
+    constexpr float LAUNCH_SPEED = 0.0025f;
+
+    constexpr float TWO_PI = 6.28318530717958647692f;
+
+    // Cephes sinf/cosf, good to a couple of ulps over [-pi/4, pi/4]
+    constexpr float SIN_P0 = -1.6666654611e-1f;
+    constexpr float SIN_P1 = 8.3321608736e-3f;
+    constexpr float SIN_P2 = -1.9515295891e-4f;
+    constexpr float COS_P0 = 4.166664568298827e-2f;
+    constexpr float COS_P1 = -1.388731625493765e-3f;
+    constexpr float COS_P2 = 2.443315711809948e-5f;
+
+    // Sine and cosine of a batch of angles given in turns, [0, 1). The nearest quarter turn comes off exactly
+    // (the turns are multiples of 2^-24), leaving |x| <= pi/4 for the polynomials, and the quadrant swaps and
+    // negates the results. One operation per statement so nothing gets fused into an FMA and the AVX2 version
+    // below gives the very same bits
+    void sinCosTurns(const float* turns, float* sines, float* cosines) {
+        for (uint32_t i = 0; i < BATCH_SIZE; i++) {
+            float quadrant = std::nearbyint(turns[i] * 4.0f);
+            float x = quadrant * 0.25f;
+            x = turns[i] - x;
+            x = x * TWO_PI;
+            float x2 = x * x;
+
+            float s = SIN_P2 * x2;
+            s = s + SIN_P1;
+            s = s * x2;
+            s = s + SIN_P0;
+            s = s * x2;
+            s = s * x;
+            s = s + x;
+
+            float c = COS_P2 * x2;
+            c = c + COS_P1;
+            c = c * x2;
+            c = c + COS_P0;
+            c = c * x2;
+            c = c * x2;
+            float half = x2 * 0.5f;
+            c = c - half;
+            c = c + 1.0f;
+
+            uint32_t q = static_cast<uint32_t>(quadrant);
+            float sine = (q & 1) ? c : s;
+            float cosine = (q & 1) ? s : c;
+            sines[i] = (q & 2) ? -sine : sine;
+            cosines[i] = ((q + 1) & 2) ? -cosine : cosine;
+        }
+    }
+
+#ifdef PARTICLE_INITIALIZER_AVX2
+    __attribute__((target("avx2")))
+    void sinCosTurnsAvx2(const float* turns, float* sines, float* cosines) {
+        __m256 t = _mm256_loadu_ps(turns);
+        __m256 quadrant = _mm256_round_ps(_mm256_mul_ps(t, _mm256_set1_ps(4.0f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 x = _mm256_sub_ps(t, _mm256_mul_ps(quadrant, _mm256_set1_ps(0.25f)));
+        x = _mm256_mul_ps(x, _mm256_set1_ps(TWO_PI));
+        __m256 x2 = _mm256_mul_ps(x, x);
+
+        __m256 s = _mm256_mul_ps(_mm256_set1_ps(SIN_P2), x2);
+        s = _mm256_add_ps(s, _mm256_set1_ps(SIN_P1));
+        s = _mm256_mul_ps(s, x2);
+        s = _mm256_add_ps(s, _mm256_set1_ps(SIN_P0));
+        s = _mm256_mul_ps(s, x2);
+        s = _mm256_mul_ps(s, x);
+        s = _mm256_add_ps(s, x);
+
+        __m256 c = _mm256_mul_ps(_mm256_set1_ps(COS_P2), x2);
+        c = _mm256_add_ps(c, _mm256_set1_ps(COS_P1));
+        c = _mm256_mul_ps(c, x2);
+        c = _mm256_add_ps(c, _mm256_set1_ps(COS_P0));
+        c = _mm256_mul_ps(c, x2);
+        c = _mm256_mul_ps(c, x2);
+        c = _mm256_sub_ps(c, _mm256_mul_ps(x2, _mm256_set1_ps(0.5f)));
+        c = _mm256_add_ps(c, _mm256_set1_ps(1.0f));
+
+        // Bit 1 of the quadrant moved up to the sign bit
+        __m256i q = _mm256_cvtps_epi32(quadrant);
+        __m256i one = _mm256_set1_epi32(1);
+        __m256i two = _mm256_set1_epi32(2);
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, one), one));
+        __m256 sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, two), 30));
+        __m256 cosineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, one), two), 30));
+
+        _mm256_storeu_ps(sines, _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sineSign));
+        _mm256_storeu_ps(cosines, _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosineSign));
+    }
+#endif
+
+    void sinCosTurnsBatch(const float* turns, float* sines, float* cosines) {
+#ifdef PARTICLE_INITIALIZER_AVX2
+        if (ParticleInitializer::hasAvx2()) {
+            sinCosTurnsAvx2(turns, sines, cosines);
+            return;
+        }
+#endif
+        sinCosTurns(turns, sines, cosines);
+    }
+}
+
+ParticleInitializer::ParticleInitializer(uint32_t seed, ParticleLayout layout, ParticleEncoding encoding, bool mass)
+    : m_seed(seed), m_layout(layout), m_encoding(encoding), m_mass(mass) {}
+
+bool ParticleInitializer::hasAvx2() {
+#ifdef PARTICLE_INITIALIZER_AVX2
+    static bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+uint32_t ParticleInitializer::getThreadCount() const {
+    return m_pool.getThreadCount();
+}
+
+void ParticleInitializer::generate(size_t stream, uint32_t firstParticle, uint32_t count, void* dst) {
+    char* out = static_cast<char*>(dst);
+
+    m_pool.parallelFor(count, [&](uint32_t begin, uint32_t end) {
+        generateRange(stream, firstParticle, begin, end, out);
+    });
+}
+
+void ParticleInitializer::generateRange(size_t stream, uint32_t firstParticle, uint32_t begin, uint32_t end, char* dst) const {
+    uint32_t stride = Particle::getStreams(m_layout, m_encoding)[stream].stride;
+
+    // SoA streams only work out what they store, position and velocity share the first draw
+    bool position = m_layout == ParticleLayout::AoS || stream == 0;
+    bool velocity = m_layout == ParticleLayout::AoS || stream == 1;
+    bool color = m_layout == ParticleLayout::AoS || stream == 2;
+
+    std::array<Particle, BATCH_SIZE> particles{};
+    std::array<float, BATCH_SIZE> turns{};
+    std::array<float, BATCH_SIZE> sines{};
+    std::array<float, BATCH_SIZE> cosines{};
+
+    for (uint32_t base = begin; base < end; base += BATCH_SIZE) {
+        uint32_t batch = std::min(BATCH_SIZE, end - base);
+
+        for (uint32_t i = 0; i < batch; i++) {
+            uint32_t index = firstParticle + base + i;
+
+            if (position || velocity) {
+                glm::vec4 random = CounterRng::unit(m_seed, CounterRng::Initialize, index, 0, 0);
+                particles[i].position = glm::vec2(random.x * 2.0f - 1.0f, random.y * 2.0f - 1.0f);
+                turns[i] = random.z;
+            }
+
+            // The N-body kernel reads the mass from the alpha
+            if (color) {
+                glm::vec4 random = CounterRng::unit(m_seed, CounterRng::Initialize, index, 0, 1);
+                particles[i].color = glm::vec4(random.x, random.y, random.z, m_mass ? 0.1f + random.w * 0.9f : 1.0f);
+            }
+        }
+
+        // Random direction, same speed for everyone
+        if (velocity) {
+            sinCosTurnsBatch(turns.data(), sines.data(), cosines.data());
+            for (uint32_t i = 0; i < batch; i++) {
+                particles[i].velocity = glm::vec2(cosines[i], sines[i]) * LAUNCH_SPEED;
+            }
+        }
+
+        for (uint32_t i = 0; i < batch; i++) {
+            Particle::encodeParticle(m_layout, m_encoding, stream, particles[i], dst + static_cast<size_t>(base + i) * stride);
+        }
+    }
+}
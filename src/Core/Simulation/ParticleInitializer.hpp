@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Core/RHI/Types/AppTypes.hpp"
+#include "Core/Simulation/ThreadPool.hpp"
+
+// Generates the initial particles straight into a stream's encoding, e.g. into staging ring memory, split
+// across a thread pool. Every particle draws from its own index on CounterRng's initialize stream, so the
+// state only depends on the seed and never on how the work got split. Launch directions are worked out
+// eight at a time, with AVX2 when the CPU has it (same bits either way)
+class ParticleInitializer {
+public:
+    ParticleInitializer(uint32_t seed, ParticleLayout layout, ParticleEncoding encoding, bool mass);
+
+    // Writes the stream's part of particles [firstParticle, firstParticle + count), stride bytes each, to dst
+    void generate(size_t stream, uint32_t firstParticle, uint32_t count, void* dst);
+
+    uint32_t getThreadCount() const;
+
+    // GCC/Clang on x86 outside Windows only, anything else takes the scalar path
+    static bool hasAvx2();
+
+private:
+    uint32_t m_seed;
+    ParticleLayout m_layout;
+    ParticleEncoding m_encoding;
+    bool m_mass;
+
+    ThreadPool m_pool;
+
+    void generateRange(size_t stream, uint32_t firstParticle, uint32_t begin, uint32_t end, char* dst) const;
+};
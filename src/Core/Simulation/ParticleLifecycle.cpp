@@ -0,0 +1,367 @@
+#include "ParticleLifecycle.hpp"
+
+#include <array>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t LIFECYCLE_BINDING_COUNT = 8;
+    constexpr uint32_t COMPACTION_BINDING_COUNT = 2;
+
+    static_assert(sizeof(Emitter) == 32, "Emitter must match its std430 layout");
+
+    void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void recordComputeToCompute(VkCommandBuffer commandBuffer) {
+        recordBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        );
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+ParticleLifecycle::ParticleLifecycle(
+    DeviceContext& deviceCtx,
+    uint32_t particleCount,
+    uint32_t slotCount,
+    uint32_t maxEmitCount,
+    uint32_t workgroupSize,
+    const std::vector<Emitter>& emitters,
+    const std::vector<uint32_t>& sharedQueueFamilies,
+    std::optional<ScanPath> compactionScan,
+    const std::string& shaderDir
+) : m_deviceCtx(deviceCtx), m_particleCount(particleCount), m_slotCount(slotCount), m_maxEmitCount(maxEmitCount),
+    m_workgroupSize(workgroupSize), m_shaderDir(shaderDir) {
+    if (emitters.empty()) {
+        throw std::runtime_error("the lifecycle needs at least one emitter!");
+    }
+
+    if (compactionScan) {
+        m_compactionScan = std::make_unique<PrefixScan>(deviceCtx, particleCount, *compactionScan, shaderDir);
+    }
+
+    createBuffers(emitters, sharedQueueFamilies);
+    createDescriptors();
+}
+
+ParticleLifecycle::~ParticleLifecycle() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_emitPipeline, nullptr);
+    vkDestroyPipeline(device, m_argsPipeline, nullptr);
+    vkDestroyPipeline(device, m_compactMarkPipeline, nullptr);
+    vkDestroyPipeline(device, m_compactScatterPipeline, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+VkDescriptorSetLayout ParticleLifecycle::getDescriptorSetLayout() const {
+    return m_descriptorSetLayout;
+}
+
+uint32_t ParticleLifecycle::getBindingCount() const {
+    return LIFECYCLE_BINDING_COUNT + (m_compactionScan ? COMPACTION_BINDING_COUNT : 0);
+}
+
+void ParticleLifecycle::createBuffers(const std::vector<Emitter>& emitters, const std::vector<uint32_t>& sharedQueueFamilies) {
+    VkDeviceSize indexBytes = static_cast<VkDeviceSize>(m_particleCount) * sizeof(uint32_t);
+
+    auto createBuffer = [&](VkDeviceSize size, VkBufferUsageFlags extraUsage, const std::vector<uint32_t>& families) {
+        return std::make_unique<GpuBuffer>(
+            m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | extraUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx.m_computeQueueCtx,
+            families
+        );
+    };
+
+    m_lifetimes = createBuffer(static_cast<VkDeviceSize>(m_particleCount) * 2 * sizeof(float), 0, {});
+    m_deadList = createBuffer(indexBytes, 0, {});
+    m_counters = createBuffer(sizeof(int32_t), 0, {});
+    m_emitters = createBuffer(emitters.size() * sizeof(Emitter), 0, {});
+    m_emitters->copyFromCpu(emitters.data(), emitters.size() * sizeof(Emitter));
+
+    if (m_compactionScan) {
+        m_compactLifetimes = createBuffer(m_lifetimes->m_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, {});
+    }
+
+    // Graphics reads these for the draw, and carry over frames copy them
+    for (uint32_t i = 0; i < m_slotCount; i++) {
+        m_aliveLists.push_back(createBuffer(indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, sharedQueueFamilies));
+        m_args.push_back(createBuffer(ARGS_SIZE, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, sharedQueueFamilies));
+    }
+}
+
+void ParticleLifecycle::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings(getBindingCount());
+    for (uint32_t i = 0; i < getBindingCount(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create lifecycle descriptor set layout!");
+    }
+
+    uint32_t setCount = m_slotCount * m_slotCount;
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = setCount * getBindingCount();
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = setCount;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create lifecycle descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    // Only a few of the pairs are ever routes, but there are few slots
+    m_descriptorSets.assign(m_slotCount, std::vector<VkDescriptorSet>(m_slotCount, VK_NULL_HANDLE));
+    for (uint32_t in = 0; in < m_slotCount; in++) {
+        for (uint32_t out = 0; out < m_slotCount; out++) {
+            if (in == out) {
+                continue;
+            }
+
+            if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSets[in][out]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate lifecycle descriptor set!");
+            }
+
+            // Binding order must match shaders/include/lifecycle.glsl
+            DescriptorWriter writer;
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 0, *m_lifetimes);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 1, *m_deadList);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 2, *m_counters);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 3, *m_emitters);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 4, *m_aliveLists[in]);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 5, *m_aliveLists[out]);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 6, *m_args[in]);
+            writer.addStorageBufferBinding(m_descriptorSets[in][out], 7, *m_args[out]);
+            if (m_compactionScan) {
+                writer.addStorageBufferBinding(m_descriptorSets[in][out], 8, m_compactionScan->getValues());
+                writer.addStorageBufferBinding(m_descriptorSets[in][out], 9, *m_compactLifetimes);
+            }
+            writer.writeAll(device);
+        }
+    }
+}
+
+VkPipeline ParticleLifecycle::createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create lifecycle pipeline! " + path);
+    }
+
+    return pipeline;
+}
+
+void ParticleLifecycle::createPipelines(VkPipelineLayout pipelineLayout) {
+    m_pipelineLayout = pipelineLayout;
+
+    // local_size_x_id = 0
+    VkSpecializationMapEntry workgroupSizeEntry{};
+    workgroupSizeEntry.constantID = 0;
+    workgroupSizeEntry.offset = 0;
+    workgroupSizeEntry.size = sizeof(uint32_t);
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &workgroupSizeEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &m_workgroupSize;
+
+    m_emitPipeline = createPipeline(m_shaderDir + "/lifecycle_emit.comp.spv", specializationInfo);
+    m_argsPipeline = createPipeline(m_shaderDir + "/lifecycle_args.comp.spv", specializationInfo);
+
+    if (m_compactionScan) {
+        m_compactMarkPipeline = createPipeline(m_shaderDir + "/lifecycle_compact_mark.comp.spv", specializationInfo);
+        m_compactScatterPipeline = createPipeline(m_shaderDir + "/lifecycle_compact_scatter.comp.spv", specializationInfo);
+    }
+}
+
+void ParticleLifecycle::initialize(const std::vector<glm::vec2>& lifetimes, uint32_t initializedSlots) {
+    if (lifetimes.size() != m_particleCount) {
+        throw std::runtime_error("expected a lifetime for every particle!");
+    }
+
+    m_lifetimes->copyFromCpu(lifetimes.data(), lifetimes.size() * sizeof(glm::vec2));
+
+    int32_t deadCount = 0;
+    m_counters->copyFromCpu(&deadCount, sizeof(deadCount));
+
+    std::vector<uint32_t> aliveList(m_particleCount);
+    for (uint32_t i = 0; i < m_particleCount; i++) {
+        aliveList[i] = i;
+    }
+
+    // VkDispatchIndirectCommand, live count, VkDrawIndexedIndirectCommand
+    std::array<uint32_t, ARGS_SIZE / sizeof(uint32_t)> args = {
+        divideRoundingUp(m_particleCount, m_workgroupSize), 1, 1,
+        m_particleCount,
+        m_particleCount, 1, 0, 0, 0
+    };
+
+    for (uint32_t i = 0; i < initializedSlots; i++) {
+        m_aliveLists[i]->copyFromCpu(aliveList.data(), aliveList.size() * sizeof(uint32_t));
+        m_args[i]->copyFromCpu(args.data(), ARGS_SIZE);
+    }
+}
+
+void ParticleLifecycle::recordStep(VkCommandBuffer commandBuffer, uint32_t inSlot, uint32_t outSlot) {
+    // Whoever read the out slot's list last is done before its count restarts
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_args[outSlot]->m_vkBuffer, ALIVE_COUNT_OFFSET, sizeof(uint32_t), 0);
+
+    // The in slot's arguments were written by the last step's lifecycle_args (or a carry over copy)
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 2, 1, &m_descriptorSets[inSlot][outSlot], 0, nullptr);
+
+    vkCmdDispatchIndirect(commandBuffer, m_args[inSlot]->m_vkBuffer, 0);
+    recordComputeToCompute(commandBuffer);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_emitPipeline);
+    vkCmdDispatch(commandBuffer, divideRoundingUp(m_maxEmitCount, m_workgroupSize), 1, 1);
+    recordComputeToCompute(commandBuffer);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_argsPipeline);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT
+    );
+}
+
+void ParticleLifecycle::recordCompact(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet, uint32_t inSlot, uint32_t outSlot) {
+    if (!m_compactionScan) {
+        throw std::runtime_error("this lifecycle was created without compaction!");
+    }
+
+    // The last compaction's scatter is done with the offsets, and the in slot's arguments are written
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_compactionScan->getValues().m_vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    auto bindSets = [&]() {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &particleSet, 0, nullptr);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 2, 1, &m_descriptorSets[inSlot][outSlot], 0, nullptr);
+    };
+
+    bindSets();
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compactMarkPipeline);
+    vkCmdDispatchIndirect(commandBuffer, m_args[inSlot]->m_vkBuffer, 0);
+    recordComputeToCompute(commandBuffer);
+
+    m_compactionScan->recordScan(commandBuffer, m_particleCount);
+
+    // The scan went through its own pipeline layout
+    bindSets();
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_compactScatterPipeline);
+    vkCmdDispatch(commandBuffer, divideRoundingUp(m_particleCount, m_workgroupSize), 1, 1);
+
+    // Lifetimes stay in place for the steps, the packed ones go back over them
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+
+    VkBufferCopy region{};
+    region.size = m_lifetimes->m_size;
+    vkCmdCopyBuffer(commandBuffer, m_compactLifetimes->m_vkBuffer, m_lifetimes->m_vkBuffer, 1, &region);
+
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+}
+
+void ParticleLifecycle::recordCarryOver(VkCommandBuffer commandBuffer, uint32_t fromSlot, uint32_t toSlot) {
+    VkBufferCopy listRegion{};
+    listRegion.size = m_aliveLists[fromSlot]->m_size;
+    vkCmdCopyBuffer(commandBuffer, m_aliveLists[fromSlot]->m_vkBuffer, m_aliveLists[toSlot]->m_vkBuffer, 1, &listRegion);
+
+    VkBufferCopy argsRegion{};
+    argsRegion.size = ARGS_SIZE;
+    vkCmdCopyBuffer(commandBuffer, m_args[fromSlot]->m_vkBuffer, m_args[toSlot]->m_vkBuffer, 1, &argsRegion);
+}
+
+void ParticleLifecycle::recordDraw(VkCommandBuffer commandBuffer, uint32_t slot) {
+    vkCmdBindIndexBuffer(commandBuffer, m_aliveLists[slot]->m_vkBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(commandBuffer, m_args[slot]->m_vkBuffer, DRAW_ARGS_OFFSET, 1, 0);
+}
+
+uint32_t ParticleLifecycle::readAliveCount(uint32_t slot) {
+    GpuBuffer readback(
+        m_deviceCtx,
+        ARGS_SIZE,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_deviceCtx.m_computeQueueCtx
+    );
+    readback.copyFromBuffer(*m_args[slot], ARGS_SIZE);
+
+    std::array<uint32_t, ARGS_SIZE / sizeof(uint32_t)> args{};
+    readback.mapAndRead(args.data(), ARGS_SIZE);
+    return args[ALIVE_COUNT_OFFSET / sizeof(uint32_t)];
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include "Core/Compute/PrefixScan.hpp"
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Must match Emitter in shaders/include/lifecycle.glsl
+struct Emitter {
+    glm::vec2 position;
+    glm::vec2 direction;
+
+    // Half angle of the launch cone, in radians
+    float spread;
+    float speed;
+
+    // Simulated time its particles live, give or take a quarter
+    float lifetime;
+    float padding = 0.0f;
+};
+
+// Particles that die and get respawned, only simulating and drawing the live ones. Every SSBO slot
+// gets a list of its live particle indices and indirect arguments for exactly those, and dead particles
+// wait on a GPU stack for the emitters to pick them up. A step (see shaders/include/lifecycle.glsl):
+//   step kernel       indirect dispatch over the in slot's live particles, listing the survivors in the out slot
+//   lifecycle_emit    respawns params.emitCount dead particles into the out slot
+//   lifecycle_args    the out slot's dispatch and draw arguments
+// Graphics draws a slot indexed by its list, with vkCmdDrawIndexedIndirect. Deaths leave holes behind, so
+// with compaction every few frames the live particles are packed to the front of another slot first.
+// The lifecycle kernels share the
+// simulation's compute pipeline layout: set 0 particles in/out, set 1 step params, set 2 the lifecycle.
+// The lists and arguments are shared by both queue families, so they never need ownership transfers
+class ParticleLifecycle {
+public:
+    // slotCount is the SSBO slots with particles of their own (simulation, scratch and the compaction's),
+    // maxEmitCount the most a single step can emit. compactionScan is the scan path compaction runs on,
+    // none without compaction. shaderDir is the compiled variant directory
+    ParticleLifecycle(
+        DeviceContext& deviceCtx,
+        uint32_t particleCount,
+        uint32_t slotCount,
+        uint32_t maxEmitCount,
+        uint32_t workgroupSize,
+        const std::vector<Emitter>& emitters,
+        const std::vector<uint32_t>& sharedQueueFamilies,
+        std::optional<ScanPath> compactionScan,
+        const std::string& shaderDir
+    );
+    ~ParticleLifecycle();
+
+    ParticleLifecycle(const ParticleLifecycle&) = delete;
+    ParticleLifecycle& operator=(const ParticleLifecycle&) = delete;
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+
+    // The layout is the simulation's compute pipeline layout
+    void createPipelines(VkPipelineLayout pipelineLayout);
+
+    // Every particle starts alive in the first initializedSlots slots, lifetimes holding its age and lifetime.
+    // Goes through the staging ring, flushed with the particles
+    void initialize(const std::vector<glm::vec2>& lifetimes, uint32_t initializedSlots);
+
+    // One step from inSlot to outSlot. Expects the step kernel bound along with sets 0 and 1, leaves the
+    // out slot's particles, list and arguments visible to the compute shaders and transfers recorded after it
+    void recordStep(VkCommandBuffer commandBuffer, uint32_t inSlot, uint32_t outSlot);
+
+    // Packs the in slot's live particles, in order, to the front of the out slot and the dead ones after
+    // them, through particleSet (in slot to out slot). The out slot's list is then 0..alive-1 and its
+    // arguments cover exactly those, ready for a step from it. Leaves the out slot visible to the compute
+    // shaders, and binds the prefix scan's own pipeline layout so anything else has to be bound again after
+    void recordCompact(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet, uint32_t inSlot, uint32_t outSlot);
+
+    // Frames without a step still need the previous slot's list in their own
+    void recordCarryOver(VkCommandBuffer commandBuffer, uint32_t fromSlot, uint32_t toSlot);
+
+    // Draws the slot's live particles, with its particle buffers bound as vertex buffers
+    void recordDraw(VkCommandBuffer commandBuffer, uint32_t slot);
+
+    // Blocking readback, for reporting
+    uint32_t readAliveCount(uint32_t slot);
+
+private:
+    // Byte offsets into a slot's argument buffer, see ArgsOutSSBO
+    static constexpr VkDeviceSize ALIVE_COUNT_OFFSET = 3 * sizeof(uint32_t);
+    static constexpr VkDeviceSize DRAW_ARGS_OFFSET = 4 * sizeof(uint32_t);
+    static constexpr VkDeviceSize ARGS_SIZE = 9 * sizeof(uint32_t);
+
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_particleCount;
+    uint32_t m_slotCount;
+    uint32_t m_maxEmitCount;
+    uint32_t m_workgroupSize;
+    std::string m_shaderDir;
+
+    std::unique_ptr<GpuBuffer> m_lifetimes;
+    std::unique_ptr<GpuBuffer> m_deadList;
+    std::unique_ptr<GpuBuffer> m_counters;
+    std::unique_ptr<GpuBuffer> m_emitters;
+
+    // Compaction only, the scan's values are the per particle flags/offsets
+    std::unique_ptr<PrefixScan> m_compactionScan;
+    std::unique_ptr<GpuBuffer> m_compactLifetimes;
+
+    // Per slot
+    std::vector<std::unique_ptr<GpuBuffer>> m_aliveLists;
+    std::vector<std::unique_ptr<GpuBuffer>> m_args;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+
+    // Indexed [in slot][out slot], the diagonal is never used
+    std::vector<std::vector<VkDescriptorSet>> m_descriptorSets;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_emitPipeline = VK_NULL_HANDLE;
+    VkPipeline m_argsPipeline = VK_NULL_HANDLE;
+    VkPipeline m_compactMarkPipeline = VK_NULL_HANDLE;
+    VkPipeline m_compactScatterPipeline = VK_NULL_HANDLE;
+
+    uint32_t getBindingCount() const;
+
+    void createBuffers(const std::vector<Emitter>& emitters, const std::vector<uint32_t>& sharedQueueFamilies);
+    void createDescriptors();
+    VkPipeline createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo);
+};
@@ -0,0 +1,406 @@
+#include "SimulationConfig.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+    std::string trim(const std::string &str) {
+        size_t first = str.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos) {
+            return "";
+        }
+        size_t last = str.find_last_not_of(" \t\r\n");
+        return str.substr(first, last - first + 1);
+    }
+
+    float parseFloat(const std::string &key, const std::string &value) {
+        try {
+            size_t consumed = 0;
+            float parsed = std::stof(value, &consumed);
+            if (consumed != value.size()) {
+                throw std::invalid_argument(value);
+            }
+            return parsed;
+        } catch (const std::exception &) {
+            throw std::runtime_error("invalid value for option '" + key + "': " + value);
+        }
+    }
+
+    bool parseBool(const std::string &key, const std::string &value) {
+        if (value == "true" || value == "1" || value == "on") {
+            return true;
+        }
+        if (value == "false" || value == "0" || value == "off") {
+            return false;
+        }
+        throw std::runtime_error("invalid value for option '" + key + "': " + value);
+    }
+}
+
+uint32_t SimulationConfig::parseUint(const std::string &key, const std::string &value) {
+    try {
+        size_t consumed = 0;
+        unsigned long long parsed = std::stoull(value, &consumed);
+        if (consumed != value.size() || parsed > UINT32_MAX) {
+            throw std::out_of_range(value);
+        }
+        return static_cast<uint32_t>(parsed);
+    } catch (const std::exception &) {
+        throw std::runtime_error("invalid value for option '" + key + "': " + value);
+    }
+}
+
+SimulationConfig SimulationConfig::fromArgs(int argc, char **argv) {
+    SimulationConfig config;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg.rfind("--", 0) != 0) {
+            throw std::runtime_error("unexpected argument: " + arg);
+        }
+
+        std::string key = arg.substr(2);
+        std::string value;
+
+        // Both "--key value" and "--key=value" are accepted
+        size_t equals = key.find('=');
+        if (equals != std::string::npos) {
+            value = key.substr(equals + 1);
+            key = key.substr(0, equals);
+        } else if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+            value = argv[++i];
+        } else {
+            // Bare flag, only makes sense for boolean options which applyOption checks
+            value = "true";
+        }
+
+        // Scenario files are applied in place, so later arguments override them
+        if (key == "scenario") {
+            config.loadScenarioFile(value);
+        } else {
+            config.applyOption(key, value);
+        }
+    }
+
+    return config;
+}
+
+void SimulationConfig::loadScenarioFile(const std::string &filepath) {
+    std::ifstream file(filepath);
+
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open scenario file! " + filepath);
+    }
+
+    std::string line;
+    uint32_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line = line.substr(0, comment);
+        }
+
+        line = trim(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error(filepath + ":" + std::to_string(lineNumber) + " expected 'key = value'");
+        }
+
+        applyOption(trim(line.substr(0, equals)), trim(line.substr(equals + 1)));
+    }
+}
+
+void SimulationConfig::applyOption(const std::string &key, const std::string &value) {
+    if (key == "particles") {
+        particleCount = parseUint(key, value);
+        if (particleCount == 0) {
+            throw std::runtime_error("particle count must be greater than zero!");
+        }
+    } else if (key == "kernel") {
+        if (value != "shader" && value != "gravity" && value != "popcorn" && value != "collide" && value != "nbody" && value != "barneshut" && value != "fountain") {
+            throw std::runtime_error("unknown compute kernel: " + value);
+        }
+        kernel = value;
+    } else if (key == "layout") {
+        if (value == "aos") {
+            layout = ParticleLayout::AoS;
+        } else if (value == "soa") {
+            layout = ParticleLayout::SoA;
+        } else {
+            throw std::runtime_error("unknown particle layout: " + value);
+        }
+    } else if (key == "encoding") {
+        if (value == "precise") {
+            encoding = ParticleEncoding::Precise;
+        } else if (value == "compact") {
+            encoding = ParticleEncoding::Compact;
+        } else {
+            throw std::runtime_error("unknown particle encoding: " + value);
+        }
+    } else if (key == "dt") {
+        deltaTime = parseFloat(key, value);
+    } else if (key == "substeps") {
+        substeps = parseUint(key, value);
+        if (substeps == 0 || substeps > MAX_SUBSTEPS) {
+            throw std::runtime_error("substeps must be between 1 and " + std::to_string(MAX_SUBSTEPS) + "!");
+        }
+    } else if (key == "step-rate") {
+        stepRate = parseFloat(key, value);
+        if (stepRate < 0.0f) {
+            throw std::runtime_error("step rate can't be negative!");
+        }
+    } else if (key == "max-substeps") {
+        maxSubsteps = parseUint(key, value);
+        if (maxSubsteps == 0 || maxSubsteps > MAX_SUBSTEPS) {
+            throw std::runtime_error("max substeps must be between 1 and " + std::to_string(MAX_SUBSTEPS) + "!");
+        }
+    } else if (key == "grid") {
+        grid = parseBool(key, value);
+    } else if (key == "grid-cell-size") {
+        gridCellSize = parseFloat(key, value);
+        if (gridCellSize <= 0.0f) {
+            throw std::runtime_error("grid cell size must be greater than zero!");
+        }
+        grid = true;
+    } else if (key == "radius") {
+        particleRadius = parseFloat(key, value);
+        if (particleRadius <= 0.0f) {
+            throw std::runtime_error("particle radius must be greater than zero!");
+        }
+    } else if (key == "restitution") {
+        restitution = parseFloat(key, value);
+        if (restitution < 0.0f || restitution > 1.0f) {
+            throw std::runtime_error("restitution must be between 0 and 1!");
+        }
+    } else if (key == "attraction") {
+        attraction = parseFloat(key, value);
+    } else if (key == "softening") {
+        softening = parseFloat(key, value);
+        if (softening <= 0.0f) {
+            throw std::runtime_error("softening must be greater than zero!");
+        }
+    } else if (key == "opening-angle") {
+        openingAngle = parseFloat(key, value);
+        if (openingAngle <= 0.0f) {
+            throw std::runtime_error("opening angle must be greater than zero!");
+        }
+    } else if (key == "emitters") {
+        emitters = parseUint(key, value);
+        if (emitters == 0) {
+            throw std::runtime_error("there has to be at least one emitter!");
+        }
+    } else if (key == "lifetime") {
+        lifetime = parseFloat(key, value);
+        if (lifetime <= 0.0f) {
+            throw std::runtime_error("lifetime must be greater than zero!");
+        }
+    } else if (key == "emit-rate") {
+        emitRate = parseFloat(key, value);
+        if (emitRate < 0.0f) {
+            throw std::runtime_error("emit rate can't be negative!");
+        }
+    } else if (key == "compact") {
+        compactInterval = parseUint(key, value);
+    } else if (key == "scan") {
+        if (value != "auto" && value != "subgroup" && value != "shared") {
+            throw std::runtime_error("unknown scan: " + value);
+        }
+        scan = value;
+    } else if (key == "morton-sort") {
+        mortonSortInterval = parseUint(key, value);
+    } else if (key == "mass") {
+        mass = parseBool(key, value);
+    } else if (key == "validate") {
+        validate = parseBool(key, value);
+    } else if (key == "seed") {
+        seed = parseUint(key, value);
+    } else if (key == "deterministic") {
+        deterministic = parseBool(key, value);
+    } else if (key == "hash-every") {
+        hashInterval = parseUint(key, value);
+    } else if (key == "hash-log") {
+        hashLog = value;
+        if (hashInterval == 0) {
+            hashInterval = 1;
+        }
+    } else if (key == "gravity") {
+        gravity = parseFloat(key, value);
+    } else if (key == "air-resist") {
+        airResist = parseFloat(key, value);
+    } else if (key == "reset-speed") {
+        resetSpeedThreshold = parseFloat(key, value);
+    } else if (key == "launch-strength") {
+        launchStrength = parseFloat(key, value);
+    } else if (key == "chunk-particles") {
+        maxChunkParticles = parseUint(key, value);
+    } else if (key == "workgroup-size") {
+        workgroupSize = parseUint(key, value);
+        if (workgroupSize == 0) {
+            throw std::runtime_error("workgroup size must be greater than zero!");
+        }
+    } else if (key == "frames-in-flight") {
+        framesInFlight = parseUint(key, value);
+        if (framesInFlight < 1 || framesInFlight > 4) {
+            throw std::runtime_error("frames in flight must be between 1 and 4!");
+        }
+    } else if (key == "triple-buffering") {
+        tripleBuffering = parseBool(key, value);
+    } else if (key == "warmup-steps") {
+        warmupSteps = parseUint(key, value);
+    } else if (key == "headless") {
+        headless = parseBool(key, value);
+    } else if (key == "steps") {
+        steps = parseUint(key, value);
+    } else if (key == "render") {
+        render = parseBool(key, value);
+    } else if (key == "output") {
+        output = value;
+        render = true;
+    } else if (key == "profile") {
+        profile = parseBool(key, value);
+    } else if (key == "profile-csv") {
+        profileCsv = value;
+        profile = true;
+    } else {
+        throw std::runtime_error("unknown option: " + key);
+    }
+}
+
+uint32_t SimulationConfig::getMaxSubsteps() const {
+    return stepRate > 0.0f ? maxSubsteps : substeps;
+}
+
+bool SimulationConfig::usesGrid() const {
+    return grid || kernel == "collide";
+}
+
+bool SimulationConfig::needsSingleChunk() const {
+    return usesGrid() || isNBody() || usesLifecycle() || mortonSortInterval > 0;
+}
+
+bool SimulationConfig::isNBody() const {
+    return kernel == "nbody" || kernel == "barneshut";
+}
+
+bool SimulationConfig::usesLifecycle() const {
+    return kernel == "fountain";
+}
+
+float SimulationConfig::getEmitRate() const {
+    return emitRate > 0.0f ? emitRate : particleCount / lifetime;
+}
+
+float SimulationConfig::getGridCellSize() const {
+    if (kernel == "collide") {
+        return std::max(gridCellSize, 2.0f * particleRadius);
+    }
+    return gridCellSize;
+}
+
+PhysicsParams SimulationConfig::getPhysics() const {
+    PhysicsParams physics{};
+
+    // The values the kernels used to hard-code
+    if (kernel == "gravity") {
+        physics.gravity = 9.8f / 1000000.0f;
+        physics.airResist = 0.9f;
+        physics.resetSpeedThreshold = 0.0005f;
+        physics.launchStrength = 0.0025f;
+    } else if (kernel == "popcorn") {
+        physics.gravity = 9.8f / 100000.0f;
+        physics.airResist = 0.9f;
+        physics.resetSpeedThreshold = 0.002f;
+        physics.launchStrength = 0.005f;
+    } else if (kernel == "collide") {
+        physics.gravity = 9.8f / 1000000.0f;
+        physics.airResist = 0.9f;
+    } else if (kernel == "fountain") {
+        physics.gravity = 9.8f / 100000.0f;
+        physics.airResist = 0.9f;
+        physics.launchStrength = 0.005f;
+    } else if (isNBody()) {
+        physics.airResist = 0.9f;
+    }
+
+    physics.particleRadius = particleRadius;
+    physics.restitution = restitution;
+    physics.attraction = attraction;
+    physics.softening = softening;
+    physics.openingAngle = openingAngle;
+
+    physics.gravity = gravity.value_or(physics.gravity);
+    physics.airResist = airResist.value_or(physics.airResist);
+    physics.resetSpeedThreshold = resetSpeedThreshold.value_or(physics.resetSpeedThreshold);
+    physics.launchStrength = launchStrength.value_or(physics.launchStrength);
+    return physics;
+}
+
+std::string SimulationConfig::getShaderVariant() const {
+    std::string variant = layout == ParticleLayout::SoA ? "soa" : "aos";
+    if (encoding == ParticleEncoding::Compact) {
+        variant += "_compact";
+    }
+    return variant;
+}
+
+void SimulationConfig::print() const {
+    std::cout << "Simulation config -v-\n";
+    std::cout << "Particles: " << particleCount << "\n";
+    std::cout << "Kernel: " << kernel << "\n";
+    std::cout << "Layout: " << getShaderVariant() << "\n";
+    std::cout << "Workgroup size: " << workgroupSize << "\n";
+    std::cout << "Frames in flight: " << framesInFlight << (tripleBuffering ? ", triple buffered" : "") << "\n";
+    if (stepRate > 0.0f) {
+        std::cout << "Fixed timestep: " << stepRate << " steps/s of dt " << deltaTime << ", at most " << maxSubsteps << " per frame\n";
+    } else if (substeps > 1) {
+        std::cout << "Substeps: " << substeps << " per frame of dt " << deltaTime << "\n";
+    }
+    if (maxChunkParticles != 0) {
+        std::cout << "Max particles per chunk: " << maxChunkParticles << "\n";
+    }
+    if (usesGrid()) {
+        std::cout << "Grid: cells of " << getGridCellSize() << "\n";
+    }
+    if (kernel == "collide") {
+        std::cout << "Collisions: radius " << particleRadius << ", restitution " << restitution << "\n";
+    }
+    if (isNBody()) {
+        std::cout << "N-body: attraction " << attraction << ", softening " << softening << (mass ? ", random masses" : "") << "\n";
+    }
+    if (kernel == "barneshut") {
+        std::cout << "Barnes-Hut: opening angle " << openingAngle << "\n";
+    }
+    if (usesLifecycle()) {
+        std::cout << "Lifecycle: " << emitters << " emitter(s), lifetime " << lifetime << ", " << getEmitRate() << " particles per unit of time\n";
+    }
+    if (usesLifecycle() && compactInterval > 0) {
+        std::cout << "Compaction: every " << compactInterval << " frames, " << scan << " scan\n";
+    }
+    if (mortonSortInterval > 0) {
+        std::cout << "Morton re-sort: every " << mortonSortInterval << " frames\n";
+    }
+    if (validate) {
+        std::cout << "Validating the first step against the CPU reference\n";
+    }
+    if (deterministic) {
+        std::cout << "Deterministic" << (seed ? "" : ", seed 0") << "\n";
+    }
+    if (hashInterval > 0) {
+        std::cout << "State hash: every " << hashInterval << " steps" << (hashLog.empty() ? "" : " to " + hashLog) << "\n";
+    }
+    if (headless) {
+        std::cout << "Headless: " << warmupSteps << " warmup + " << steps << " steps" << (render ? ", rendering offscreen" : "") << "\n";
+    }
+    if (profile) {
+        std::cout << "Profiling" << (profileCsv.empty() ? "" : " to " + profileCsv) << "\n";
+    }
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "Core/RHI/Types/AppTypes.hpp"
+
+// Physics constants, copied into every step's SimulationParams (the dynamic UBO at set 1, binding 0)
+struct PhysicsParams {
+    float gravity = 0.0f;
+    float airResist = 0.0f;
+
+    // Particles resting on the floor slower than this get launched again
+    float resetSpeedThreshold = 0.0f;
+    float launchStrength = 0.0f;
+
+    // Collision kernel only, the radius can't grow past half a grid cell while running
+    float particleRadius = 0.0f;
+    float restitution = 0.0f;
+
+    // N-body kernels only, the opening angle is the Barnes-Hut one
+    float attraction = 0.0f;
+    float softening = 0.0f;
+    float openingAngle = 0.0f;
+};
+
+// Every runtime knob of the simulation, filled from the command line and/or a scenario file.
+// Scenario files are plain "key = value" lines ('#' starts a comment), and every key can also
+// be given on the command line as "--key value", e.g. "--particles 4194304 --kernel gravity".
+// Boolean keys may drop the value on the command line, "--headless" is "--headless true".
+struct SimulationConfig {
+    uint32_t particleCount = 1048576;
+
+    // Compute kernel, by shader name: "shader", "gravity", "popcorn", "collide" (discs colliding
+    // with each other, always uses the grid), "nbody" (all pairs attraction, single chunk only),
+    // "barneshut" (the same attraction approximated through a tree rebuilt every step) or "fountain"
+    // (particles that age and die, respawned by emitters, single chunk only)
+    std::string kernel = "popcorn";
+
+    // Particle memory layout: "aos" or "soa"
+    ParticleLayout layout = ParticleLayout::AoS;
+
+    // Particle encoding: "precise" (32 bytes) or "compact" (16 bytes, fp16 velocity and rgba8 color)
+    ParticleEncoding encoding = ParticleEncoding::Precise;
+
+    // Caps the particles per SSBO chunk below what the device allows, 0 means device limit
+    uint32_t maxChunkParticles = 0;
+
+    // Simulated time advanced by every compute step
+    float deltaTime = 0.2f;
+
+    // Compute steps per frame, all recorded into the frame's single compute submission.
+    // With a step rate the count follows the wall clock instead: an accumulator adds up frame
+    // times and every 1/stepRate seconds worth of it is one step, capped at maxSubsteps per frame.
+    uint32_t substeps = 1;
+    float stepRate = 0.0f;
+    uint32_t maxSubsteps = 8;
+
+    // Every substep is its own dispatch(es) and SimulationParams slice, past this a frame is just a stall
+    static constexpr uint32_t MAX_SUBSTEPS = 1024;
+
+    // Uniform neighbor grid rebuilt before every step, which also sorts the particles by cell.
+    // Needs the aos layout and every particle in a single chunk
+    bool grid = false;
+    float gridCellSize = 1.0f / 64.0f;
+
+    // Collision discs, the grid cells are grown to at least a diameter so neighbors are one cell away.
+    // The default packs the default million particles into about three quarters of the box
+    float particleRadius = 0.001f;
+    float restitution = 0.8f;
+
+    // N-body pull strength (scaled for tens of thousands of unit masses) and softening length.
+    // With mass every particle gets a random one, stored in its color alpha (aos layouts only).
+    // Barnes-Hut pulls with a whole tree cell at once when its size over its distance is under the opening angle
+    float attraction = 1e-10f;
+    float softening = 0.01f;
+    bool mass = false;
+    float openingAngle = 0.5f;
+
+    // Fountain kernel only: emitters spread along the floor, particles living about lifetime simulated time.
+    // The emit rate is in particles per unit of simulated time, 0 keeps the live count around particleCount
+    uint32_t emitters = 3;
+    float lifetime = 100.0f;
+    float emitRate = 0.0f;
+
+    // Fountain kernel only: packs the live particles to the front of the buffers every this many frames,
+    // 0 is never. Needs the aos layout like the grid
+    uint32_t compactInterval = 0;
+
+    // Workgroup scan used by the compaction (and by the benchmark's --scan): "auto" takes subgroup
+    // arithmetic when the device has it, "subgroup" insists on it, "shared" always scans in shared memory
+    std::string scan = "auto";
+
+    // Re-sorts the particles by the Morton code of their position every this many frames, 0 is never.
+    // Keeps particles close in the box close in memory. Same restrictions as the grid, which already
+    // sorts every step and can't be combined with it
+    uint32_t mortonSortInterval = 0;
+
+    // Runs the first step on both the GPU and the kernel's CPU reference and compares them before starting
+    bool validate = false;
+
+    // Seeds every random draw of the run (initial particles and kernels), unset picks one from the clock.
+    // Deterministic runs default to seed 0 and refuse anything that wouldn't replay bit for bit
+    // (the step rate, the grid, the lifecycle)
+    std::optional<uint32_t> seed;
+    bool deterministic = false;
+
+    // Hashes the whole particle state on the GPU every this many steps, 0 is never. One "step <n> <hash>"
+    // line per hash to the log, or stdout without one, so two runs can be diffed
+    uint32_t hashInterval = 0;
+    std::string hashLog;
+
+    // Physics overrides, anything left unset uses the kernel's own default
+    std::optional<float> gravity;
+    std::optional<float> airResist;
+    std::optional<float> resetSpeedThreshold;
+    std::optional<float> launchStrength;
+
+    // Frames the CPU may record ahead of the GPU, 1 to 4
+    uint32_t framesInFlight = 2;
+
+    // Graphics always draws the last finished state while compute writes the next one. Double buffering
+    // draws the state compute is reading from, so with separate queue families the SSBOs are shared
+    // concurrently. Triple buffering draws one state further back, which lets every buffer belong to a
+    // single queue at a time (explicit ownership transfers) at the cost of one more frame of latency
+    bool tripleBuffering = false;
+
+    // Compute local_size_x, fed to the kernels as specialization constant 0
+    uint32_t workgroupSize = 256;
+
+    // No window or swap chain, runs the simulation for a fixed amount of steps and exits
+    bool headless = false;
+    uint32_t steps = 1000;
+
+    // Headless only: steps run before any timing or profiling starts
+    uint32_t warmupSteps = 0;
+
+    // Headless only: also draw every step into an offscreen image, optionally saved as a PPM at the end
+    bool render = false;
+    std::string output;
+
+    // GPU timestamps/pipeline statistics per pass, summary printed at exit and optionally every frame to a CSV
+    bool profile = false;
+    std::string profileCsv;
+
+    static SimulationConfig fromArgs(int argc, char **argv);
+
+    // A whole decimal uint32, anything else throws naming the option. Public for the bench's lists
+    static uint32_t parseUint(const std::string &key, const std::string &value);
+
+    void loadScenarioFile(const std::string &filepath);
+    void applyOption(const std::string &key, const std::string &value);
+
+    // Most steps a single frame can ask for
+    uint32_t getMaxSubsteps() const;
+
+    bool usesGrid() const;
+    float getGridCellSize() const;
+
+    // Kernels reading particles of other chunks, or anything sorting them
+    bool needsSingleChunk() const;
+
+    // Both gravity kernels, all pairs and Barnes-Hut
+    bool isNBody() const;
+
+    // Kernels with a particle lifecycle, only simulating and drawing the live particles
+    bool usesLifecycle() const;
+
+    // Particles emitted per unit of simulated time
+    float getEmitRate() const;
+
+    // Kernel defaults with the overrides applied
+    PhysicsParams getPhysics() const;
+
+    // Name of the compiled shader variant directory for the chosen layout and encoding
+    std::string getShaderVariant() const;
+
+    void print() const;
+};
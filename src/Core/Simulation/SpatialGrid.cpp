@@ -0,0 +1,256 @@
+#include "SpatialGrid.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t GRID_BINDING_COUNT = 4;
+
+    void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void recordComputeToCompute(VkCommandBuffer commandBuffer) {
+        recordBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+        );
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+SpatialGrid::SpatialGrid(DeviceContext& deviceCtx, uint32_t particleCount, float cellSize, ScanPath scanPath, const std::string& shaderDir)
+    : m_deviceCtx(deviceCtx), m_particleCount(particleCount) {
+    if (cellSize <= 0.0f) {
+        throw std::runtime_error("grid cell size must be greater than zero!");
+    }
+
+    m_gridDim = static_cast<uint32_t>(std::ceil(2.0f / cellSize));
+    if (m_gridDim > MAX_GRID_DIM) {
+        throw std::runtime_error("grid cell size is too small, at most " + std::to_string(MAX_GRID_DIM) + " cells per axis!");
+    }
+    m_cellSize = cellSize;
+
+    m_scan = std::make_unique<PrefixScan>(deviceCtx, getCellCount(), scanPath, shaderDir);
+
+    createBuffers();
+    createDescriptors();
+}
+
+SpatialGrid::~SpatialGrid() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_countPipeline, nullptr);
+    vkDestroyPipeline(device, m_scatterPipeline, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+VkDescriptorSetLayout SpatialGrid::getDescriptorSetLayout() const {
+    return m_descriptorSetLayout;
+}
+
+VkDescriptorSet SpatialGrid::getDescriptorSet() const {
+    return m_descriptorSet;
+}
+
+uint32_t SpatialGrid::getGridDim() const {
+    return m_gridDim;
+}
+
+uint32_t SpatialGrid::getCellCount() const {
+    return m_gridDim * m_gridDim;
+}
+
+float SpatialGrid::getCellSize() const {
+    return m_cellSize;
+}
+
+GridSpecialization SpatialGrid::getSpecialization(uint32_t workgroupSize) const {
+    return { workgroupSize, m_gridDim, m_cellSize };
+}
+
+std::array<VkSpecializationMapEntry, 3> SpatialGrid::getSpecializationEntries() {
+    std::array<VkSpecializationMapEntry, 3> entries{};
+
+    entries[0].constantID = 0;
+    entries[0].offset = offsetof(GridSpecialization, workgroupSize);
+    entries[0].size = sizeof(uint32_t);
+
+    entries[1].constantID = 1;
+    entries[1].offset = offsetof(GridSpecialization, gridDim);
+    entries[1].size = sizeof(uint32_t);
+
+    entries[2].constantID = 2;
+    entries[2].offset = offsetof(GridSpecialization, cellSize);
+    entries[2].size = sizeof(float);
+
+    return entries;
+}
+
+void SpatialGrid::createBuffers() {
+    VkDeviceSize cellBytes = static_cast<VkDeviceSize>(getCellCount()) * sizeof(uint32_t);
+    VkDeviceSize particleBytes = static_cast<VkDeviceSize>(m_particleCount) * sizeof(uint32_t);
+
+    auto createBuffer = [&](VkDeviceSize size, VkBufferUsageFlags extraUsage) {
+        return std::make_unique<GpuBuffer>(
+            m_deviceCtx,
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            m_deviceCtx.m_computeQueueCtx
+        );
+    };
+
+    // Counts are cleared with vkCmdFillBuffer before every build, and copied into the scan after counting
+    m_cellCounts = createBuffer(cellBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    m_particleCells = createBuffer(particleBytes, 0);
+    m_particleRanks = createBuffer(particleBytes, 0);
+}
+
+void SpatialGrid::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    std::array<VkDescriptorSetLayoutBinding, GRID_BINDING_COUNT> bindings{};
+    for (uint32_t i = 0; i < GRID_BINDING_COUNT; i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create grid descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = GRID_BINDING_COUNT;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create grid descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate grid descriptor set!");
+    }
+
+    // Binding order must match shaders/include/grid.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, *m_cellCounts);
+    writer.addStorageBufferBinding(m_descriptorSet, 1, m_scan->getValues());
+    writer.addStorageBufferBinding(m_descriptorSet, 2, *m_particleCells);
+    writer.addStorageBufferBinding(m_descriptorSet, 3, *m_particleRanks);
+    writer.writeAll(device);
+}
+
+VkPipeline SpatialGrid::createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo) {
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create grid pipeline! " + path);
+    }
+
+    return pipeline;
+}
+
+void SpatialGrid::createPipelines(VkPipelineLayout pipelineLayout, const std::string& shaderDir, uint32_t workgroupSize) {
+    m_pipelineLayout = pipelineLayout;
+    m_workgroupSize = workgroupSize;
+
+    GridSpecialization specialization = getSpecialization(workgroupSize);
+    std::array<VkSpecializationMapEntry, 3> entries = getSpecializationEntries();
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specializationInfo.pMapEntries = entries.data();
+    specializationInfo.dataSize = sizeof(specialization);
+    specializationInfo.pData = &specialization;
+
+    m_countPipeline = createPipeline(shaderDir + "/grid_count.comp.spv", specializationInfo);
+    m_scatterPipeline = createPipeline(shaderDir + "/grid_scatter.comp.spv", specializationInfo);
+}
+
+void SpatialGrid::recordBuild(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet) {
+    uint32_t particleGroups = divideRoundingUp(m_particleCount, m_workgroupSize);
+
+    // The last build's readers are done with the counts and starts before they get overwritten
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_cellCounts->m_vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &particleSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 2, 1, &m_descriptorSet, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_countPipeline);
+    vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+
+    // The counts stay as they are for gridCellEnd(), the scan gets a copy
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+    );
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = static_cast<VkDeviceSize>(getCellCount()) * sizeof(uint32_t);
+    vkCmdCopyBuffer(commandBuffer, m_cellCounts->m_vkBuffer, m_scan->getValues().m_vkBuffer, 1, &copyRegion);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    // Binds its own layout, so the sets go back in after
+    m_scan->recordScan(commandBuffer, getCellCount());
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &particleSet, 0, nullptr);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 2, 1, &m_descriptorSet, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_scatterPipeline);
+    vkCmdDispatch(commandBuffer, particleGroups, 1, 1);
+    recordComputeToCompute(commandBuffer);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/Compute/PrefixScan.hpp"
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Specialization constants of every kernel including shaders/include/grid.glsl, id 0 is the workgroup size
+struct GridSpecialization {
+    uint32_t workgroupSize;
+    uint32_t gridDim;
+    float cellSize;
+};
+
+// Uniform grid neighbor structure over the [-1, 1] box, built on the GPU every step with a counting sort:
+//   grid_count    bins the particles and atomically counts them per cell
+//   PrefixScan    exclusive prefix sum of a copy of the counts, which is the cell start table
+//   grid_scatter  copies every particle to its sorted place
+// Kernels running after a build see the particles sorted by cell, with the tables in descriptor set 2.
+// The grid kernels share the simulation's compute pipeline layout:
+//   set 0 particles in/out, set 1 step params, set 2 the grid
+class SpatialGrid {
+public:
+    // Keeps the tables at a few MB
+    static constexpr uint32_t MAX_GRID_DIM = 1024;
+
+    // scanPath is the cell count scan's. shaderDir is the compiled variant directory
+    SpatialGrid(DeviceContext& deviceCtx, uint32_t particleCount, float cellSize, ScanPath scanPath, const std::string& shaderDir);
+    ~SpatialGrid();
+
+    SpatialGrid(const SpatialGrid&) = delete;
+    SpatialGrid& operator=(const SpatialGrid&) = delete;
+
+    VkDescriptorSetLayout getDescriptorSetLayout() const;
+    VkDescriptorSet getDescriptorSet() const;
+
+    uint32_t getGridDim() const;
+    uint32_t getCellCount() const;
+    float getCellSize() const;
+
+    GridSpecialization getSpecialization(uint32_t workgroupSize) const;
+    static std::array<VkSpecializationMapEntry, 3> getSpecializationEntries();
+
+    // The layout is the simulation's compute pipeline layout, shaderDir the compiled variant directory
+    void createPipelines(VkPipelineLayout pipelineLayout, const std::string& shaderDir, uint32_t workgroupSize);
+
+    // Sorts the particles bound as in/out by particleSet into the out buffers. Leaves the grid pipelines
+    // and sets 0 and 2 bound, and the sorted particles and tables visible to the compute shaders recorded after it
+    void recordBuild(VkCommandBuffer commandBuffer, VkDescriptorSet particleSet);
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_particleCount;
+    uint32_t m_gridDim;
+    float m_cellSize;
+    uint32_t m_workgroupSize = 0;
+
+    std::unique_ptr<GpuBuffer> m_cellCounts;
+    std::unique_ptr<GpuBuffer> m_particleCells;
+    std::unique_ptr<GpuBuffer> m_particleRanks;
+
+    // Its values are the cell start table
+    std::unique_ptr<PrefixScan> m_scan;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_countPipeline = VK_NULL_HANDLE;
+    VkPipeline m_scatterPipeline = VK_NULL_HANDLE;
+
+    void createBuffers();
+    void createDescriptors();
+    VkPipeline createPipeline(const std::string& path, const VkSpecializationInfo& specializationInfo);
+};
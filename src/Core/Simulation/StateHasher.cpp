@@ -0,0 +1,242 @@
+#include "StateHasher.hpp"
+
+#include <array>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "Core/Descriptor/DescriptorWriter.hpp"
+#include "Core/RHI/Pipeline/ShaderStageBuilder.hpp"
+
+namespace {
+    constexpr uint32_t SUM_COUNT = 2;
+    constexpr VkDeviceSize SUM_BYTES = SUM_COUNT * sizeof(uint32_t);
+
+    void recordBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    uint32_t divideRoundingUp(uint32_t value, uint32_t divisor) {
+        return (value + divisor - 1) / divisor;
+    }
+}
+
+StateHasher::StateHasher(
+    DeviceContext& deviceCtx,
+    uint32_t workgroupSize,
+    uint32_t framesInFlight,
+    VkDescriptorSetLayout particleSetLayout,
+    const std::string& logPath,
+    const std::string& shaderDir
+) : m_deviceCtx(deviceCtx), m_workgroupSize(workgroupSize), m_pendingSteps(framesInFlight, 0) {
+    if (!logPath.empty()) {
+        m_log.open(logPath);
+        if (!m_log.is_open()) {
+            throw std::runtime_error("failed to open state hash log! " + logPath);
+        }
+    }
+
+    createBuffers(framesInFlight);
+    createDescriptors();
+    createPipeline(particleSetLayout, shaderDir);
+}
+
+StateHasher::~StateHasher() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    vkDestroyPipeline(device, m_hashPipeline, nullptr);
+    vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+
+    vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+}
+
+void StateHasher::createBuffers(uint32_t framesInFlight) {
+    // Reset with vkCmdFillBuffer before every hash
+    m_sums = std::make_unique<GpuBuffer>(
+        m_deviceCtx,
+        SUM_BYTES,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_deviceCtx.m_computeQueueCtx
+    );
+
+    m_readback = std::make_unique<GpuBuffer>(
+        m_deviceCtx,
+        SUM_BYTES * framesInFlight,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        m_deviceCtx.m_computeQueueCtx
+    );
+}
+
+void StateHasher::createDescriptors() {
+    VkDevice device = m_deviceCtx.m_logicalDevice;
+
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorCount = 1;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create state hash descriptor set layout!");
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 1;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    poolInfo.maxSets = 1;
+
+    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create state hash descriptor pool!");
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = m_descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+    if (vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate state hash descriptor set!");
+    }
+
+    // Binding order must match shaders/include/state_hash.glsl
+    DescriptorWriter writer;
+    writer.addStorageBufferBinding(m_descriptorSet, 0, *m_sums);
+    writer.writeAll(device);
+}
+
+void StateHasher::createPipeline(VkDescriptorSetLayout particleSetLayout, const std::string& shaderDir) {
+    std::array<VkDescriptorSetLayout, 2> setLayouts = { particleSetLayout, m_descriptorSetLayout };
+
+    VkPushConstantRange pushConstants{};
+    pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstants.offset = 0;
+    pushConstants.size = sizeof(uint32_t);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    layoutInfo.pSetLayouts = setLayouts.data();
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushConstants;
+
+    if (vkCreatePipelineLayout(m_deviceCtx.m_logicalDevice, &layoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create state hash pipeline layout!");
+    }
+
+    // local_size_x_id = 0
+    VkSpecializationMapEntry workgroupSizeEntry{};
+    workgroupSizeEntry.constantID = 0;
+    workgroupSizeEntry.offset = 0;
+    workgroupSizeEntry.size = sizeof(uint32_t);
+
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &workgroupSizeEntry;
+    specializationInfo.dataSize = sizeof(uint32_t);
+    specializationInfo.pData = &m_workgroupSize;
+
+    std::string path = shaderDir + "/state_hash.comp.spv";
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.layout = m_pipelineLayout;
+    pipelineInfo.stage = ShaderStageBuilder::createShaderStage(m_deviceCtx.m_logicalDevice, VK_SHADER_STAGE_COMPUTE_BIT, path);
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+
+    if (vkCreateComputePipelines(m_deviceCtx.m_logicalDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_hashPipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create state hash pipeline! " + path);
+    }
+}
+
+void StateHasher::recordHash(VkCommandBuffer commandBuffer, const std::vector<VkDescriptorSet>& particleSets, const std::vector<uint32_t>& chunkSizes, uint32_t frame) {
+    // The last hash's kernel and copy are done before the sums get reset
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+    vkCmdFillBuffer(commandBuffer, m_sums->m_vkBuffer, 0, VK_WHOLE_SIZE, 0);
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+    );
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_hashPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 1, 1, &m_descriptorSet, 0, nullptr);
+
+    uint32_t firstParticle = 0;
+    for (size_t chunk = 0; chunk < particleSets.size(); chunk++) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &particleSets[chunk], 0, nullptr);
+        vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &firstParticle);
+        vkCmdDispatch(commandBuffer, divideRoundingUp(chunkSizes[chunk], m_workgroupSize), 1, 1);
+        firstParticle += chunkSizes[chunk];
+    }
+
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT
+    );
+
+    VkBufferCopy copyRegion{};
+    copyRegion.dstOffset = SUM_BYTES * frame;
+    copyRegion.size = SUM_BYTES;
+    vkCmdCopyBuffer(commandBuffer, m_sums->m_vkBuffer, m_readback->m_vkBuffer, 1, &copyRegion);
+
+    recordBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT
+    );
+}
+
+void StateHasher::submitted(uint32_t frame, uint64_t step) {
+    m_pendingSteps[frame] = step;
+}
+
+void StateHasher::collect(uint32_t frame) {
+    if (m_pendingSteps[frame] == 0) {
+        return;
+    }
+    uint64_t step = m_pendingSteps[frame];
+    m_pendingSteps[frame] = 0;
+
+    uint32_t sums[SUM_COUNT];
+    std::memcpy(sums, static_cast<const char*>(m_readback->getMapped()) + SUM_BYTES * frame, SUM_BYTES);
+
+    std::ostringstream line;
+    line << "step " << step << " " << std::hex << std::setfill('0') << std::setw(8) << sums[1] << std::setw(8) << sums[0];
+
+    if (m_log.is_open()) {
+        m_log << line.str() << "\n";
+    } else {
+        std::cout << "State hash: " << line.str() << "\n";
+    }
+    m_hashCount++;
+}
+
+uint32_t StateHasher::getHashCount() const {
+    return m_hashCount;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+#include "Core/RHI/DeviceContext.hpp"
+#include "Core/RHI/GpuBuffer.hpp"
+
+// Hashes the simulated state of a slot on the GPU (see shaders/include/state_hash.glsl) and logs
+// "step <n> <hash>" lines, so two builds or two runs can be diffed step by step. Only 8 bytes per hash
+// reach the host: like MortonReorder the sums of a frame are copied to host memory and only read
+// once the frame slot comes around again. Has its own pipeline layout (set 0 the simulation's particle
+// set, set 1 the sums)
+class StateHasher {
+public:
+    // logPath empty logs to stdout. shaderDir is the compiled variant directory
+    StateHasher(
+        DeviceContext& deviceCtx,
+        uint32_t workgroupSize,
+        uint32_t framesInFlight,
+        VkDescriptorSetLayout particleSetLayout,
+        const std::string& logPath,
+        const std::string& shaderDir
+    );
+    ~StateHasher();
+
+    StateHasher(const StateHasher&) = delete;
+    StateHasher& operator=(const StateHasher&) = delete;
+
+    // Hashes the in buffers of every chunk's particle set, chunkSizes particles each in order. Expects their
+    // writes made visible to compute shaders before. Binds its own pipeline layout, anything else has to
+    // be bound again after
+    void recordHash(VkCommandBuffer commandBuffer, const std::vector<VkDescriptorSet>& particleSets, const std::vector<uint32_t>& chunkSizes, uint32_t frame);
+
+    // Same pattern as GpuProfiler, step being the steps run once the hashed frame is done
+    void submitted(uint32_t frame, uint64_t step);
+    void collect(uint32_t frame);
+
+    uint32_t getHashCount() const;
+
+private:
+    DeviceContext& m_deviceCtx;
+
+    uint32_t m_workgroupSize;
+
+    std::ofstream m_log;
+
+    // The two sums, and a copy of them per frame slot
+    std::unique_ptr<GpuBuffer> m_sums;
+    std::unique_ptr<GpuBuffer> m_readback;
+
+    // Step of the frame slot's pending hash, 0 when there's none
+    std::vector<uint64_t> m_pendingSteps;
+    uint32_t m_hashCount = 0;
+
+    VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+    VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline m_hashPipeline = VK_NULL_HANDLE;
+
+    void createBuffers(uint32_t framesInFlight);
+    void createDescriptors();
+    void createPipeline(VkDescriptorSetLayout particleSetLayout, const std::string& shaderDir);
+};
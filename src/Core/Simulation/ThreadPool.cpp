@@ -0,0 +1,84 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    for (uint32_t i = 1; i < threadCount; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+uint32_t ThreadPool::getThreadCount() const {
+    return static_cast<uint32_t>(m_workers.size()) + 1;
+}
+
+void ThreadPool::parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& body) {
+    if (m_workers.empty() || count < getThreadCount()) {
+        body(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_body = &body;
+        m_count = count;
+        m_pending = static_cast<uint32_t>(m_workers.size());
+        m_generation++;
+    }
+    m_wake.notify_all();
+
+    runShare(body, count, 0);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_body = nullptr;
+}
+
+void ThreadPool::workerLoop(uint32_t share) {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [&] { return m_stopping || m_generation != seenGeneration; });
+        if (m_stopping) {
+            return;
+        }
+
+        seenGeneration = m_generation;
+        const std::function<void(uint32_t, uint32_t)>& body = *m_body;
+        uint32_t count = m_count;
+        lock.unlock();
+
+        runShare(body, count, share);
+
+        lock.lock();
+        if (--m_pending == 0) {
+            m_done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::runShare(const std::function<void(uint32_t, uint32_t)>& body, uint32_t count, uint32_t share) const {
+    uint64_t shares = getThreadCount();
+    uint32_t begin = static_cast<uint32_t>(static_cast<uint64_t>(count) * share / shares);
+    uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(count) * (share + 1) / shares);
+    if (begin < end) {
+        body(begin, end);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for splitting big CPU side loops, the calling thread takes a share too.
+// One loop at a time, parallelFor() blocks until every share ran
+class ThreadPool {
+public:
+    // 0 takes one thread per hardware thread
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Workers plus the calling thread
+    uint32_t getThreadCount() const;
+
+    // Splits [0, count) into one contiguous range per thread, body gets called with (begin, end) once per range
+    void parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& body);
+
+private:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // The running loop, a new generation wakes the workers up
+    const std::function<void(uint32_t, uint32_t)>* m_body = nullptr;
+    uint32_t m_count = 0;
+    uint64_t m_generation = 0;
+    uint32_t m_pending = 0;
+    bool m_stopping = false;
+
+    void workerLoop(uint32_t share);
+    void runShare(const std::function<void(uint32_t, uint32_t)>& body, uint32_t count, uint32_t share) const;
+};
@@ -1,9 +1,8 @@
 #include "Core/ParticleSimulation.hpp"
 
-int main() {
-    ParticleSimulation app;
-
+int main(int argc, char **argv) {
     try {
+        ParticleSimulation app(SimulationConfig::fromArgs(argc, argv));
         app.run();
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;